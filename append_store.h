@@ -0,0 +1,239 @@
+// Append-optimized sorted store for growing datasets (LSM-style).
+//
+// Appended batches are sorted on their own and kept as small delta runs
+// next to a large sorted base run. Median and quantile queries search all
+// runs at once by rank (see sorted_runs_median.h), so a batch costs
+// O(batch log batch) rather than a full re-sort. Once deltas pile up they
+// are merged into the base on a background thread; runs are immutable and
+// shared, so queries keep working on a consistent snapshot meanwhile.
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+#include "sorted_runs_median.h"
+
+
+// A growing dataset answering median and quantile queries. Indices are
+// positions in append order.
+class AppendStore
+{
+public:
+    // Deltas are merged into the base when there are more than
+    // "maxDeltaRuns" of them, or when they hold more than 1/8 of the base.
+    explicit AppendStore(size_t maxDeltaRuns = 8) : maxDeltaRuns_(maxDeltaRuns) {}
+
+    ~AppendStore()
+    {
+        waitForMerge();
+    }
+
+    AppendStore(const AppendStore&) = delete;
+    AppendStore& operator=(const AppendStore&) = delete;
+
+    // Appends a batch: sorts it with its indices into a new delta run.
+    void append(const std::vector<double>& batch)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> appendLock(appendMutex_);
+        const auto first = appended_;
+        appended_ += batch.size();
+
+        std::vector<std::pair<double, size_t> > sorted;
+        sorted.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            sorted.emplace_back(batch[i], first + i);
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        auto values = std::make_shared<std::vector<double> >();
+        auto indices = std::make_shared<std::vector<size_t> >();
+        values->reserve(sorted.size());
+        indices->reserve(sorted.size());
+        for (const auto& [value, index] : sorted)
+        {
+            values->push_back(value);
+            indices->push_back(index);
+        }
+
+        bool merge = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            values_.push_back(std::move(values));
+            indices_.push_back(std::move(indices));
+            size_t deltas = 0;
+            for (size_t r = 1; r < values_.size(); ++r)
+            {
+                deltas += values_[r]->size();
+            }
+            merge = !merging_ && values_.size() > 1 &&
+                (values_.size() - 1 > maxDeltaRuns_ || 8 * deltas > values_.front()->size());
+            merging_ = merging_ || merge;
+        }
+        if (merge)
+        {
+            startMerge();
+        }
+    }
+
+    // Number of appended elements.
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t total = 0;
+        for (const auto& run : values_)
+        {
+            total += run->size();
+        }
+        return total;
+    }
+
+    // Number of sorted runs, base included.
+    size_t runs() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return values_.size();
+    }
+
+    // Median with the append positions of its central element(s).
+    MedianResult median() const
+    {
+        const auto [values, indices] = snapshot();
+        size_t total = 0;
+        for (const auto& run : values)
+        {
+            total += run->size();
+        }
+        return valueOfRanks(values, indices, middleRanks(total));
+    }
+
+    // The q-quantile (0 <= q <= 1) by linear interpolation between the two
+    // closest ranks, with the append positions of those elements.
+    MedianResult quantile(double q) const
+    {
+        const auto [values, indices] = snapshot();
+        size_t total = 0;
+        for (const auto& run : values)
+        {
+            total += run->size();
+        }
+        if (total == 0)
+        {
+            return emptyMedianResult();
+        }
+
+        const auto position = std::clamp(q, 0.0, 1.0) * (total - 1);
+        const auto lower = static_cast<size_t>(position);
+        const auto fraction = position - lower;
+        if (fraction == 0.0)
+        {
+            return valueOfRanks(values, indices, {lower});
+        }
+        const auto [a, first] = valueOfRanks(values, indices, {lower});
+        const auto [b, second] = valueOfRanks(values, indices, {lower + 1});
+        return std::make_tuple(a + fraction * (b - a),
+            std::vector<size_t>{first.front(), second.front()});
+    }
+
+    // Blocks until a background merge, if any, has finished.
+    void waitForMerge()
+    {
+        std::lock_guard<std::mutex> lock(mergeThreadMutex_);
+        if (mergeThread_.joinable())
+        {
+            mergeThread_.join();
+        }
+    }
+
+private:
+    using Values = std::vector<std::shared_ptr<const std::vector<double> > >;
+    using Indices = std::vector<std::shared_ptr<const std::vector<size_t> > >;
+
+    std::tuple<Values, Indices> snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::make_tuple(values_, indices_);
+    }
+
+    // Mean of the elements of the given ranks across the runs.
+    static MedianResult valueOfRanks(const Values& values, const Indices& indices,
+        const std::vector<size_t>& ranks)
+    {
+        if (ranks.empty())
+        {
+            return emptyMedianResult();
+        }
+        double sum = 0.0;
+        std::vector<size_t> originalIndices;
+        for (const auto rank : ranks)
+        {
+            const auto [run, offset] = selectFromRuns(values, rank);
+            sum += (*values[run])[offset];
+            originalIndices.push_back((*indices[run])[offset]);
+        }
+        return std::make_tuple(sum / originalIndices.size(), originalIndices);
+    }
+
+    // Merges the runs present now into a new base on a background thread.
+    // Runs appended in the meantime stay behind the new base.
+    void startMerge()
+    {
+        waitForMerge();
+        const auto [values, indices] = snapshot();
+
+        std::lock_guard<std::mutex> lock(mergeThreadMutex_);
+        mergeThread_ = std::thread([this, values = values, indices = indices]()
+        {
+            std::vector<std::pair<double, size_t> > merged;
+            for (size_t r = 0; r < values.size(); ++r)
+            {
+                const auto middle = merged.size();
+                for (size_t i = 0; i < values[r]->size(); ++i)
+                {
+                    merged.emplace_back((*values[r])[i], (*indices[r])[i]);
+                }
+                std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end());
+            }
+
+            auto baseValues = std::make_shared<std::vector<double> >();
+            auto baseIndices = std::make_shared<std::vector<size_t> >();
+            baseValues->reserve(merged.size());
+            baseIndices->reserve(merged.size());
+            for (const auto& [value, index] : merged)
+            {
+                baseValues->push_back(value);
+                baseIndices->push_back(index);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            values_.erase(values_.begin(), values_.begin() + values.size());
+            indices_.erase(indices_.begin(), indices_.begin() + indices.size());
+            values_.insert(values_.begin(), std::move(baseValues));
+            indices_.insert(indices_.begin(), std::move(baseIndices));
+            merging_ = false;
+        });
+    }
+
+    size_t maxDeltaRuns_;
+    size_t appended_ = 0;
+    bool merging_ = false;
+    Values values_;
+    Indices indices_;
+    mutable std::mutex mutex_;
+    std::mutex appendMutex_;
+    std::mutex mergeThreadMutex_;
+    std::thread mergeThread_;
+};
@@ -0,0 +1,77 @@
+// Sampling-based approximate median with a rank-error guarantee.
+//
+// By the Dvoretzky-Kiefer-Wolfowitz inequality, the empirical distribution
+// of s uniform samples is within eps of the true one everywhere with
+// probability at least 1 - delta once s >= ln(2 / delta) / (2 eps^2). The
+// median of such a sample therefore has a rank within n * eps of the true
+// median rank, and the sample size does not depend on n at all.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Approximate median value, the original index of the sampled element(s)
+// it came from, and the interval [lowRank, highRank] of 0-based ranks in
+// the full input that contains the ranks of those elements with
+// probability at least 1 - delta.
+using ApproximateMedian = std::tuple<double, std::vector<size_t>, size_t, size_t>;
+
+
+// Number of uniform samples that bounds the rank error of the sample
+// median by eps with probability at least 1 - delta.
+inline size_t approximateSampleSize(double eps, double delta)
+{
+    return static_cast<size_t>(std::ceil(std::log(2.0 / delta) / (2.0 * eps * eps)));
+}
+
+
+// Approximate median of the elements within rank error eps * n with
+// confidence 1 - delta. Falls back to the exact median, with an exact rank
+// interval, when the sample would not be smaller than the input.
+inline ApproximateMedian approximateMedian(const std::vector<double>& elements,
+    double eps = 0.01, double delta = 0.001, uint64_t seed = 0)
+{
+    const auto size = elements.size();
+    const auto sampleSize = approximateSampleSize(eps, delta);
+
+    std::vector<std::pair<size_t, double> > sample;
+    if (sampleSize >= size)
+    {
+        sample.reserve(size);
+        for (size_t index = 0; index < size; ++index)
+        {
+            sample.emplace_back(index, elements[index]);
+        }
+        const auto [median, indices] = selectMedian(sample);
+        const auto ranks = middleRanks(size);
+        return std::make_tuple(median, indices,
+            ranks.empty() ? 0 : ranks.front(), ranks.empty() ? 0 : ranks.back());
+    }
+
+    std::mt19937_64 generator(seed);
+    std::uniform_int_distribution<size_t> pick(0, size - 1);
+    sample.reserve(sampleSize);
+    for (size_t i = 0; i < sampleSize; ++i)
+    {
+        const auto index = pick(generator);
+        sample.emplace_back(index, elements[index]);
+    }
+    const auto [median, indices] = selectMedian(sample);
+
+    const auto slack = eps * size;
+    const auto ranks = middleRanks(size);
+    const auto lowRank = static_cast<size_t>(
+        std::max(0.0, std::floor(ranks.front() - slack)));
+    const auto highRank = static_cast<size_t>(
+        std::min(size - 1.0, std::ceil(ranks.back() + slack)));
+    return std::make_tuple(median, indices, lowRank, highRank);
+}
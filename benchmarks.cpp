@@ -0,0 +1,195 @@
+// Micro-benchmarks for the median routines whose point is speed.
+//
+// Each benchmark times a few alternative ways of computing the same median
+// on synthetic data and prints the best of several runs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "median.h"
+#include "median_polish.h"
+#include "string_median.h"
+#include "theil_sen.h"
+
+
+// Best wall time in milliseconds of "runs" calls of func.
+template<typename Func>
+double bestMilliseconds(Func&& func, int runs = 5)
+{
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto stop = std::chrono::steady_clock::now();
+        best = std::min(best,
+            std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    return best;
+}
+
+
+// A 64-byte record of which only one field takes part in the median.
+struct Record
+{
+    double latency;
+    uint64_t id;
+    char payload[48];
+};
+static_assert(sizeof(Record) == 64, "records are meant to fill a cache line");
+
+
+// Median of one field of 64-byte records: copying the field out first,
+// the projection overload, and selecting the records themselves.
+void projectionBenchmark(size_t size)
+{
+    std::mt19937_64 generator(1);
+    std::exponential_distribution<double> latency(0.01);
+    std::vector<Record> records(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        records[i].latency = latency(generator);
+        records[i].id = i;
+        std::memset(records[i].payload, 0, sizeof(records[i].payload));
+    }
+
+    double sink = 0.0;
+    const auto copied = bestMilliseconds([&]()
+    {
+        std::vector<double> field;
+        field.reserve(size);
+        for (const auto& record : records)
+        {
+            field.push_back(record.latency);
+        }
+        sink += std::get<0>(median(field));
+    });
+    const auto projected = bestMilliseconds([&]()
+    {
+        sink += std::get<0>(median(records, &Record::latency));
+    });
+    const auto direct = bestMilliseconds([&]()
+    {
+        auto copy = records;
+        const auto middle = copy.begin() + size / 2;
+        std::nth_element(copy.begin(), middle, copy.end(),
+            [](const Record& a, const Record& b) { return a.latency < b.latency; });
+        sink += middle->latency;
+    });
+
+    std::cout << "projection n=" << size
+        << " copy_field=" << copied << "ms"
+        << " projection=" << projected << "ms"
+        << " select_records=" << direct << "ms"
+        << " (checksum " << sink << ")" << std::endl;
+}
+
+
+// Median of URL-like strings: the comparator path on the strings, the
+// prefix-cached path, and selecting copies of the strings themselves.
+void stringBenchmark(size_t size)
+{
+    std::mt19937_64 generator(2);
+    const std::vector<std::string> hosts {
+        "www.example.com", "api.example.com", "cdn.example.net", "example.org"
+        };
+    std::vector<std::string> urls(size);
+    for (auto& url : urls)
+    {
+        url = "https://" + hosts[generator() % hosts.size()] + "/items/";
+        url += std::to_string(generator() % 100000) + "?page=" + std::to_string(generator() % 50);
+    }
+
+    size_t sink = 0;
+    const auto compared = bestMilliseconds([&]()
+    {
+        sink += std::get<1>(medianKey(urls)).front();
+    });
+    const auto prefixed = bestMilliseconds([&]()
+    {
+        sink += std::get<1>(stringMedian(urls)).front();
+    });
+    const auto direct = bestMilliseconds([&]()
+    {
+        auto copy = urls;
+        const auto middle = copy.begin() + size / 2;
+        std::nth_element(copy.begin(), middle, copy.end());
+        sink += middle->size();
+    });
+
+    std::cout << "strings n=" << size
+        << " comparator=" << compared << "ms"
+        << " prefix_cached=" << prefixed << "ms"
+        << " select_strings=" << direct << "ms"
+        << " (checksum " << sink << ")" << std::endl;
+}
+
+
+// Median polish of a rows x columns table of additive effects plus noise:
+// the time of a full fit (copying the table included) and its sweeps.
+void medianPolishBenchmark(size_t rows, size_t columns)
+{
+    std::mt19937_64 generator(3);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> table(rows * columns);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        for (size_t column = 0; column < columns; ++column)
+        {
+            table[row * columns + column] = 0.01 * row - 0.02 * column + noise(generator);
+        }
+    }
+
+    size_t sweeps = 0;
+    const auto fitted = bestMilliseconds([&]()
+    {
+        auto copy = table;
+        sweeps = std::get<3>(medianPolish(copy.data(), rows, columns));
+    }, 3);
+
+    std::cout << "median_polish " << rows << "x" << columns
+        << " threads=" << workerCount(rows)
+        << " fit=" << fitted << "ms"
+        << " sweeps=" << sweeps << std::endl;
+}
+
+
+// Repeated-median line fits of noisy points, with real-valued and with
+// integer coordinates (many equal slopes).
+void repeatedMedianBenchmark(size_t size)
+{
+    std::mt19937_64 generator(4);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> x(size), y(size), xTied(size), yTied(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        x[i] = noise(generator);
+        y[i] = 2 * x[i] + noise(generator);
+        xTied[i] = static_cast<double>(generator() % 400);
+        yTied[i] = static_cast<double>(generator() % 50);
+    }
+
+    double slope = 0.0, tiedSlope = 0.0;
+    const auto real = bestMilliseconds([&]() { slope = std::get<0>(repeatedMedian(x, y)); }, 3);
+    const auto tied = bestMilliseconds(
+        [&]() { tiedSlope = std::get<0>(repeatedMedian(xTied, yTied)); }, 3);
+
+    std::cout << "repeated_median " << size
+        << " real=" << real << "ms (slope " << slope << ")"
+        << " integer=" << tied << "ms (slope " << tiedSlope << ")" << std::endl;
+}
+
+
+int main()
+{
+    projectionBenchmark(5000000);
+    stringBenchmark(2000000);
+    medianPolishBenchmark(5000, 5000);
+    repeatedMedianBenchmark(100000);
+    return 0;
+}
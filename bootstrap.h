@@ -0,0 +1,172 @@
+// Parallel bootstrap confidence intervals for the median.
+//
+// A bootstrap resample of n elements is fully described by how many times
+// each element was drawn, i.e. by multinomial counts, so nothing is ever
+// copied. Over data sorted once up front, the median of a resample is the
+// element where the running count crosses the middle rank. The counts of
+// a range split into the counts of its halves by a binomial draw, so the
+// descent to the middle rank draws only O(log n) of them per replicate.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// A counter-based random generator: the output is a hash of (seed, stream,
+// counter), so each bootstrap replicate owns an independent stream and
+// the results do not depend on how replicates are spread over threads.
+class CounterRng
+{
+public:
+    using result_type = uint64_t;
+
+    CounterRng(uint64_t seed, uint64_t stream) :
+        key_(mix(seed ^ mix(stream + 0x9e3779b97f4a7c15ull))) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() { return mix(key_ + 0x9e3779b97f4a7c15ull * ++counter_); }
+
+private:
+    // The SplitMix64 finalizer.
+    static uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key_;
+    uint64_t counter_ = 0;
+};
+
+
+// Position in [lo, hi) of the element of the given rank in a resample
+// that drew "total" elements from that range.
+inline size_t resampledRank(size_t lo, size_t hi, uint64_t total, uint64_t rank,
+    CounterRng& rng)
+{
+    while (hi - lo > 1)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        const auto left = std::binomial_distribution<uint64_t>(
+            total, static_cast<double>(mid - lo) / (hi - lo))(rng);
+        if (rank < left)
+        {
+            hi = mid;
+            total = left;
+        }
+        else
+        {
+            lo = mid;
+            rank -= left;
+            total -= left;
+        }
+    }
+    return lo;
+}
+
+
+// Median of one bootstrap resample of sorted values. Both central ranks of
+// an even-sized resample are found in the same draw of counts: the descent
+// is shared until they fall into different halves.
+inline double resampledMedian(const std::vector<double>& sorted, CounterRng& rng)
+{
+    const auto n = sorted.size();
+    const auto ranks = middleRanks(n);
+    if (ranks.size() == 1)
+    {
+        return sorted[resampledRank(0, n, n, ranks.front(), rng)];
+    }
+
+    size_t lo = 0, hi = n;
+    uint64_t total = n, first = ranks.front(), second = ranks.back();
+    while (hi - lo > 1)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        const auto left = std::binomial_distribution<uint64_t>(
+            total, static_cast<double>(mid - lo) / (hi - lo))(rng);
+        if (second < left)
+        {
+            hi = mid;
+            total = left;
+        }
+        else if (first >= left)
+        {
+            lo = mid;
+            first -= left;
+            second -= left;
+            total -= left;
+        }
+        else
+        {
+            const auto lower = resampledRank(lo, mid, left, first, rng);
+            const auto upper = resampledRank(mid, hi, total - left, second - left, rng);
+            return (sorted[lower] + sorted[upper]) / 2;
+        }
+    }
+    return sorted[lo];
+}
+
+
+// Median of the elements with a percentile bootstrap confidence interval
+// at the given confidence level. Returns the median value, its indices,
+// and the lower and upper bounds of the interval, which are NaN when there
+// are no replicates. Replicates run in parallel; the same seed always
+// gives the same interval.
+inline std::tuple<double, std::vector<size_t>, double, double> bootstrapMedian(
+    const std::vector<double>& elements, size_t replicates = 2000,
+    double confidence = 0.95, uint64_t seed = 0)
+{
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    if (elements.empty())
+    {
+        const auto [median, indices] = emptyMedianResult();
+        return std::make_tuple(median, indices, nan, nan);
+    }
+
+    std::vector<std::pair<size_t, double> > enumerated;
+    enumerated.reserve(elements.size());
+    for (size_t index = 0; index < elements.size(); ++index)
+    {
+        enumerated.emplace_back(index, elements[index]);
+    }
+    const auto [median, indices] = selectMedian(enumerated);
+    if (replicates == 0)
+    {
+        return std::make_tuple(median, indices, nan, nan);
+    }
+
+    std::vector<double> sorted(elements);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<double> medians(replicates);
+    parallelFor(replicates, [&](size_t begin, size_t end, size_t)
+    {
+        for (size_t replicate = begin; replicate < end; ++replicate)
+        {
+            CounterRng rng(seed, replicate);
+            medians[replicate] = resampledMedian(sorted, rng);
+        }
+    });
+    std::sort(medians.begin(), medians.end());
+
+    const auto tail = (1.0 - confidence) / 2;
+    const auto quantile = [&](double q)
+    {
+        const auto position = static_cast<size_t>(std::floor(q * (replicates - 1)));
+        return medians[std::min(position, replicates - 1)];
+    };
+    return std::make_tuple(median, indices, quantile(tail), quantile(1.0 - tail));
+}
@@ -0,0 +1,95 @@
+// Time-bucketed median downsampling of time series sorted by time.
+//
+// Points are pushed one at a time; while they fall into the current time
+// bucket they go into a single workspace that is reused for every bucket,
+// and once a point from a later bucket arrives the finished bucket's
+// median is selected and emitted. Empty buckets (gaps in irregular
+// sampling) are simply skipped.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// A downsampled point: bucket number, median value and the original
+// indices of the point(s) the median came from.
+using BucketMedian = std::tuple<int64_t, double, std::vector<size_t> >;
+
+
+// Streaming bucketed median. Bucket b covers timestamps in
+// [origin + b * width, origin + (b + 1) * width). For every non-empty
+// bucket emit(bucket, median, indices) is called once, in time order.
+template<typename Emit>
+class BucketedMedian
+{
+public:
+    BucketedMedian(int64_t width, int64_t origin, Emit emit) :
+        width_(width), origin_(origin), emit_(std::move(emit)) {}
+
+    // Adds the next point. Timestamps must not decrease.
+    void push(int64_t timestamp, double value)
+    {
+        const auto bucket = bucketOf(timestamp);
+        if (!workspace_.empty() && bucket != bucket_)
+        {
+            flush();
+        }
+        bucket_ = bucket;
+        workspace_.emplace_back(index_++, value);
+    }
+
+    // Emits the last, still open bucket.
+    void finish()
+    {
+        if (!workspace_.empty())
+        {
+            flush();
+        }
+    }
+
+private:
+    int64_t bucketOf(int64_t timestamp) const
+    {
+        // Floor division, so that timestamps before the origin work too.
+        const auto offset = timestamp - origin_;
+        return offset / width_ - (offset % width_ < 0 ? 1 : 0);
+    }
+
+    void flush()
+    {
+        const auto [median, indices] = selectMedian(workspace_);
+        emit_(bucket_, median, indices);
+        workspace_.clear();
+    }
+
+    int64_t width_;
+    int64_t origin_;
+    Emit emit_;
+    int64_t bucket_ = 0;
+    size_t index_ = 0;
+    std::vector<std::pair<size_t, double> > workspace_;
+};
+
+
+// Downsamples a whole series given as parallel timestamp and value arrays.
+inline std::vector<BucketMedian> bucketedMedians(
+    const std::vector<int64_t>& timestamps, const std::vector<double>& values,
+    int64_t width, int64_t origin = 0)
+{
+    std::vector<BucketMedian> result;
+    BucketedMedian downsampler(width, origin,
+        [&result](int64_t bucket, double median, const std::vector<size_t>& indices)
+        { result.emplace_back(bucket, median, indices); });
+    for (size_t i = 0; i < std::min(timestamps.size(), values.size()); ++i)
+    {
+        downsampler.push(timestamps[i], values[i]);
+    }
+    downsampler.finish();
+    return result;
+}
@@ -0,0 +1,58 @@
+// Checks compressedMedian (compressed_median.h) against a sorted copy of
+// the column, with thread limits up to more threads than there are blocks,
+// so some chunkings leave workers with a single block.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "compressed_median.h"
+
+
+int main()
+{
+    int failures = 0;
+    std::mt19937_64 generator(7);
+    for (const size_t size : {1, 127, 128, 129, 600, 1000, 5000})
+    {
+        std::vector<int64_t> values(size);
+        for (auto& value : values)
+        {
+            value = static_cast<int64_t>(generator() % 100000) - 50000;
+        }
+        auto sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        const auto expected = (static_cast<double>(sorted[(size - 1) / 2]) +
+            static_cast<double>(sorted[size / 2])) / 2;
+        const auto blocks = (size + kCompressedBlockSize - 1) / kCompressedBlockSize;
+
+        for (const bool delta : {false, true})
+        {
+            for (size_t threads = 1; threads <= blocks + 3; ++threads)
+            {
+                const auto [median_value, rows] =
+                    compressedMedian(compressColumn(values, delta), threads);
+                auto ok = median_value == expected && rows.size() == (size % 2 == 1 ? 1 : 2);
+                for (const auto row : rows)
+                {
+                    ok = ok && row < size && (values[row] == sorted[(size - 1) / 2] ||
+                        values[row] == sorted[size / 2]);
+                }
+                if (!ok)
+                {
+                    std::cerr << "size=" << size << " delta=" << delta << " threads="
+                        << threads << " failed: median_value=" << median_value
+                        << " expected=" << expected << std::endl;
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    std::cout << (failures == 0 ? "compressed checks passed" : "compressed checks failed")
+        << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
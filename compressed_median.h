@@ -0,0 +1,298 @@
+// Median over frame-of-reference / delta-compressed integer blocks.
+//
+// Columns of timestamps and counters are kept as blocks of up to 128
+// values. A frame-of-reference (FOR) block stores every value as an
+// offset from the block's reference; a delta block stores the first value
+// as the reference and every following one as an offset from the smallest
+// difference between neighbours. Offsets are bit-packed at the narrowest
+// width that fits, and every block also records its minimum and maximum.
+//
+// The median is found by histogram narrowing over the value range: each
+// round splits the current range into buckets, decodes only the blocks
+// that overlap it into a small stack buffer, and keeps the bucket holding
+// the target rank. Blocks entirely below or above the range contribute
+// their size from the metadata alone, so they are never decoded.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// Number of values per compressed block.
+constexpr size_t kCompressedBlockSize = 128;
+
+// Number of buckets of one histogram narrowing round.
+constexpr size_t kNarrowingBuckets = 1024;
+
+
+// One compressed block of at most kCompressedBlockSize values.
+struct CompressedBlock
+{
+    int64_t reference;
+    int64_t offset;
+    int64_t minimum;
+    int64_t maximum;
+    uint32_t size;
+    uint8_t bitWidth;
+    bool delta;
+    std::vector<uint64_t> words;
+};
+
+
+// Decodes a block into "out", which must hold kCompressedBlockSize values.
+// Arithmetic is carried out on unsigned integers, so that wrap-around in
+// the deltas is well defined.
+inline void decodeBlock(const CompressedBlock& block, int64_t* out)
+{
+    uint64_t packed[kCompressedBlockSize];
+    const auto width = block.bitWidth;
+    const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    for (size_t i = 0; i < block.size; ++i)
+    {
+        if (width == 0)
+        {
+            packed[i] = 0;
+            continue;
+        }
+        const auto bit = i * width;
+        const auto shift = bit % 64;
+        auto value = block.words[bit / 64] >> shift;
+        if (shift + width > 64)
+        {
+            value |= block.words[bit / 64 + 1] << (64 - shift);
+        }
+        packed[i] = value & mask;
+    }
+
+    const auto reference = static_cast<uint64_t>(block.reference);
+    if (!block.delta)
+    {
+        for (size_t i = 0; i < block.size; ++i)
+        {
+            out[i] = static_cast<int64_t>(reference + packed[i]);
+        }
+        return;
+    }
+    auto value = reference;
+    const auto offset = static_cast<uint64_t>(block.offset);
+    out[0] = static_cast<int64_t>(value);
+    for (size_t i = 1; i < block.size; ++i)
+    {
+        value += offset + packed[i];
+        out[i] = static_cast<int64_t>(value);
+    }
+}
+
+
+// Compresses a column into blocks, FOR-encoded or delta-encoded. This is
+// the encoder side of the format, used to build inputs.
+inline std::vector<CompressedBlock> compressColumn(const std::vector<int64_t>& values,
+    bool delta)
+{
+    std::vector<CompressedBlock> blocks;
+    for (size_t first = 0; first < values.size(); first += kCompressedBlockSize)
+    {
+        const auto size = std::min(kCompressedBlockSize, values.size() - first);
+        const auto begin = values.begin() + first;
+        const auto [minimum, maximum] = std::minmax_element(begin, begin + size);
+
+        CompressedBlock block{};
+        block.size = static_cast<uint32_t>(size);
+        block.minimum = *minimum;
+        block.maximum = *maximum;
+        block.delta = delta;
+
+        std::vector<uint64_t> offsets(size, 0);
+        if (delta)
+        {
+            block.reference = begin[0];
+            block.offset = std::numeric_limits<int64_t>::max();
+            for (size_t i = 1; i < size; ++i)
+            {
+                block.offset = std::min(block.offset, begin[i] - begin[i - 1]);
+            }
+            for (size_t i = 1; i < size; ++i)
+            {
+                offsets[i] = static_cast<uint64_t>(begin[i] - begin[i - 1] - block.offset);
+            }
+        }
+        else
+        {
+            block.reference = block.minimum;
+            for (size_t i = 0; i < size; ++i)
+            {
+                offsets[i] = static_cast<uint64_t>(begin[i]) -
+                    static_cast<uint64_t>(block.reference);
+            }
+        }
+
+        const auto largest = *std::max_element(offsets.begin(), offsets.end());
+        while (block.bitWidth < 64 && (largest >> block.bitWidth) != 0)
+        {
+            ++block.bitWidth;
+        }
+        block.words.assign((size * block.bitWidth + 63) / 64 + 1, 0);
+        for (size_t i = 0; i < size && block.bitWidth > 0; ++i)
+        {
+            const auto bit = i * block.bitWidth;
+            const auto shift = bit % 64;
+            block.words[bit / 64] |= offsets[i] << shift;
+            if (shift + block.bitWidth > 64)
+            {
+                block.words[bit / 64 + 1] |= offsets[i] >> (64 - shift);
+            }
+        }
+        blocks.push_back(std::move(block));
+    }
+    return blocks;
+}
+
+
+// Row and value of the element of the given rank in a compressed column.
+// Equal values are ordered by row. At most "threadLimit" threads decode.
+inline std::pair<size_t, int64_t> selectCompressedRank(
+    const std::vector<CompressedBlock>& blocks, size_t rank,
+    size_t threadLimit = hardwareThreads())
+{
+    auto lo = std::numeric_limits<int64_t>::max();
+    auto hi = std::numeric_limits<int64_t>::min();
+    for (const auto& block : blocks)
+    {
+        lo = std::min(lo, block.minimum);
+        hi = std::max(hi, block.maximum);
+    }
+
+    const auto workers = workerCount(blocks.size(), threadLimit);
+    std::vector<std::vector<size_t> > counts(workers,
+        std::vector<size_t>(kNarrowingBuckets, 0));
+    std::vector<size_t> belows(workers, 0);
+    int64_t value = lo;
+    size_t before = 0;
+    while (true)
+    {
+        // The range [lo, hi] is split into buckets of "width" values.
+        const auto span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+        const auto width = span / kNarrowingBuckets + 1;
+        for (auto& histogram : counts)
+        {
+            std::fill(histogram.begin(), histogram.end(), 0);
+        }
+
+        parallelFor(blocks.size(), workers, [&](size_t begin, size_t end, size_t worker)
+        {
+            auto& histogram = counts[worker];
+            size_t below = 0;
+            int64_t decoded[kCompressedBlockSize];
+            for (size_t b = begin; b < end; ++b)
+            {
+                const auto& block = blocks[b];
+                if (block.maximum < lo)
+                {
+                    below += block.size;
+                    continue;
+                }
+                if (block.minimum > hi)
+                {
+                    continue;
+                }
+                decodeBlock(block, decoded);
+                for (size_t i = 0; i < block.size; ++i)
+                {
+                    if (decoded[i] < lo)
+                    {
+                        ++below;
+                    }
+                    else if (decoded[i] <= hi)
+                    {
+                        const auto offset = static_cast<uint64_t>(decoded[i]) -
+                            static_cast<uint64_t>(lo);
+                        ++histogram[offset / width];
+                    }
+                }
+            }
+            belows[worker] = below;
+        });
+
+        before = std::accumulate(belows.begin(), belows.end(), size_t{0});
+        size_t bucket = 0;
+        for (; bucket < kNarrowingBuckets; ++bucket)
+        {
+            size_t inBucket = 0;
+            for (const auto& histogram : counts)
+            {
+                inBucket += histogram[bucket];
+            }
+            if (rank < before + inBucket)
+            {
+                break;
+            }
+            before += inBucket;
+        }
+
+        const auto bucketLo = static_cast<int64_t>(static_cast<uint64_t>(lo) + bucket * width);
+        if (width == 1)
+        {
+            value = bucketLo;
+            break;
+        }
+        hi = std::min(hi, static_cast<int64_t>(static_cast<uint64_t>(bucketLo) + (width - 1)));
+        lo = bucketLo;
+    }
+
+    // Locate the occurrence of the value among its equals, decoding only
+    // blocks whose range contains it.
+    auto occurrence = rank - before;
+    size_t row = 0;
+    int64_t decoded[kCompressedBlockSize];
+    for (const auto& block : blocks)
+    {
+        if (block.minimum <= value && value <= block.maximum)
+        {
+            decodeBlock(block, decoded);
+            for (size_t i = 0; i < block.size; ++i)
+            {
+                if (decoded[i] == value && occurrence-- == 0)
+                {
+                    return std::make_pair(row + i, value);
+                }
+            }
+        }
+        row += block.size;
+    }
+    return std::make_pair(row, value);
+}
+
+
+// Median of a compressed column with the row(s) it was computed from.
+// At most "threadLimit" threads decode.
+inline MedianResult compressedMedian(const std::vector<CompressedBlock>& blocks,
+    size_t threadLimit = hardwareThreads())
+{
+    size_t total = 0;
+    for (const auto& block : blocks)
+    {
+        total += block.size;
+    }
+    if (total == 0)
+    {
+        return emptyMedianResult();
+    }
+
+    std::vector<size_t> rows;
+    double sum = 0.0;
+    for (const auto rank : middleRanks(total))
+    {
+        const auto [row, value] = selectCompressedRank(blocks, rank, threadLimit);
+        rows.push_back(row);
+        sum += static_cast<double>(value);
+    }
+    return std::make_tuple(sum / rows.size(), rows);
+}
@@ -0,0 +1,231 @@
+// Median of every column of a numeric CSV file.
+//
+// The first line names the columns; every other non-empty line is a row.
+// The text is split into one chunk per worker at line boundaries. A first
+// parallel pass counts the rows of every chunk, which fixes where each
+// chunk's rows go, and a second pass parses the chunks with
+// std::from_chars straight into preallocated per-column arrays. The
+// column medians are then computed in parallel. Cells that are empty or
+// not numbers are stored as NaN and left out of their column's median.
+
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fused_median.h"
+#include "median.h"
+#include "parallel.h"
+
+
+// A parsed CSV file: column names and one array of values per column,
+// indexed by data row (the header is not a row).
+struct CsvTable
+{
+    std::vector<std::string> names;
+    std::vector<std::vector<double> > columns;
+    size_t rows = 0;
+};
+
+
+// Reads a whole file into "text". False if it cannot be read. Files that
+// cannot report their size (pipes, FIFOs, /dev/stdin) are read in chunks.
+inline bool readFile(const std::string& path, std::string& text)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    const auto size = file.tellg();
+    if (size != std::streampos(-1))
+    {
+        text.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        return static_cast<bool>(file.read(&text[0], text.size()));
+    }
+
+    file.clear();
+    text.clear();
+    std::vector<char> chunk(1 << 20);
+    while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0)
+    {
+        text.append(chunk.data(), static_cast<size_t>(file.gcount()));
+    }
+    return file.eof() && !file.bad();
+}
+
+
+// Calls func(begin, end) for every non-empty line of [begin, end), without
+// the line break ("\n" or "\r\n").
+template<typename Func>
+void forEachLine(const char* begin, const char* end, Func&& func)
+{
+    while (begin < end)
+    {
+        auto lineEnd = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const auto next = lineEnd == nullptr ? end : lineEnd + 1;
+        lineEnd = lineEnd == nullptr ? end : lineEnd;
+        if (lineEnd > begin && lineEnd[-1] == '\r')
+        {
+            --lineEnd;
+        }
+        if (lineEnd > begin)
+        {
+            func(begin, lineEnd);
+        }
+        begin = next;
+    }
+}
+
+
+// Calls func(column, begin, end) for the fields of a line, with
+// surrounding spaces and double quotes removed.
+template<typename Func>
+void forEachField(const char* begin, const char* end, Func&& func)
+{
+    for (size_t column = 0; begin <= end; ++column)
+    {
+        auto fieldEnd = static_cast<const char*>(std::memchr(begin, ',', end - begin));
+        const auto next = (fieldEnd == nullptr ? end : fieldEnd) + 1;
+        fieldEnd = fieldEnd == nullptr ? end : fieldEnd;
+        auto first = begin;
+        while (first < fieldEnd && (*first == ' ' || *first == '"'))
+        {
+            ++first;
+        }
+        while (fieldEnd > first && (fieldEnd[-1] == ' ' || fieldEnd[-1] == '"'))
+        {
+            --fieldEnd;
+        }
+        func(column, first, fieldEnd);
+        begin = next;
+    }
+}
+
+
+// The number in a field, or NaN if the field is not exactly one number.
+inline double parseField(const char* begin, const char* end)
+{
+    if (begin < end && *begin == '+')
+    {
+        ++begin;
+    }
+    double value = std::numeric_limits<double>::quiet_NaN();
+    const auto [last, error] = std::from_chars(begin, end, value);
+    if (error != std::errc() || last != end)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return value;
+}
+
+
+// Splits [begin, end) into about "parts" pieces that start at line starts.
+inline std::vector<const char*> lineAlignedBounds(
+    const char* begin, const char* end, size_t parts)
+{
+    std::vector<const char*> bounds {begin};
+    for (size_t part = 1; part < parts; ++part)
+    {
+        const auto bound = std::max(bounds.back(), begin + (end - begin) * part / parts);
+        const auto newline = static_cast<const char*>(std::memchr(bound, '\n', end - bound));
+        bounds.push_back(newline == nullptr ? end : newline + 1);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+
+// Parses CSV text with a header line.
+inline CsvTable parseCsv(const std::string& text)
+{
+    CsvTable table;
+    const auto end = text.data() + text.size();
+    auto headerEnd = static_cast<const char*>(std::memchr(text.data(), '\n', text.size()));
+    headerEnd = headerEnd == nullptr ? end : headerEnd;
+    forEachLine(text.data(), headerEnd, [&](const char* begin, const char* last)
+    {
+        forEachField(begin, last, [&](size_t, const char* first, const char* fieldEnd)
+        {
+            table.names.emplace_back(first, fieldEnd);
+        });
+    });
+    if (table.names.empty())
+    {
+        return table;
+    }
+
+    const auto bodyBegin = headerEnd == end ? end : headerEnd + 1;
+    const auto workers = workerCount(static_cast<size_t>(end - bodyBegin) / 65536 + 1);
+    const auto bounds = lineAlignedBounds(bodyBegin, end, workers);
+    const auto chunks = bounds.size() - 1;
+
+    // Rows per chunk, then the first row of every chunk.
+    std::vector<size_t> firstRows(chunks + 1, 0);
+    parallelFor(chunks, [&](size_t begin, size_t last, size_t)
+    {
+        for (size_t chunk = begin; chunk < last; ++chunk)
+        {
+            size_t rows = 0;
+            forEachLine(bounds[chunk], bounds[chunk + 1],
+                [&rows](const char*, const char*) { ++rows; });
+            firstRows[chunk + 1] = rows;
+        }
+    });
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        firstRows[chunk + 1] += firstRows[chunk];
+    }
+    table.rows = firstRows.back();
+
+    // Missing cells stay NaN.
+    table.columns.assign(table.names.size(),
+        std::vector<double>(table.rows, std::numeric_limits<double>::quiet_NaN()));
+    parallelFor(chunks, [&](size_t begin, size_t last, size_t)
+    {
+        for (size_t chunk = begin; chunk < last; ++chunk)
+        {
+            auto row = firstRows[chunk];
+            forEachLine(bounds[chunk], bounds[chunk + 1],
+                [&](const char* line, const char* lineEnd)
+            {
+                forEachField(line, lineEnd,
+                    [&](size_t column, const char* first, const char* fieldEnd)
+                {
+                    if (column < table.columns.size())
+                    {
+                        table.columns[column][row] = parseField(first, fieldEnd);
+                    }
+                });
+                ++row;
+            });
+        }
+    });
+    return table;
+}
+
+
+// Median of every column with the rows of its central element(s), in
+// parallel over the columns. NaN cells are skipped.
+inline std::vector<MedianResult> columnMedians(const CsvTable& table)
+{
+    std::vector<MedianResult> results(table.columns.size());
+    parallelFor(table.columns.size(), [&](size_t begin, size_t end, size_t)
+    {
+        for (size_t column = begin; column < end; ++column)
+        {
+            results[column] = fusedMedian(table.columns[column],
+                [](double value) { return !std::isnan(value); },
+                [](double value) { return value; });
+        }
+    });
+    return results;
+}
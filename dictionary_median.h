@@ -0,0 +1,180 @@
+// Median over dictionary-encoded, bit-packed integer columns.
+//
+// A low-cardinality column is stored as a dictionary of distinct values
+// plus one fixed-width code per row, packed back to back into 64-bit
+// words. The median only needs how often every code occurs: the stream
+// is unpacked block by block into a small buffer and histogrammed, the
+// median code is found by walking the histogram in dictionary value
+// order, and one more scan of the packed stream recovers the row(s).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// A bit-packed stream of "size" codes of "bitWidth" bits (1 to 32): code i
+// occupies bits [i * bitWidth, (i + 1) * bitWidth) of the little-endian
+// word stream, least significant bit first.
+struct PackedCodes
+{
+    const uint64_t* words;
+    size_t size;
+    unsigned bitWidth;
+};
+
+
+// Packs codes into the layout described above; the counterpart of the
+// storage engine's encoder, used to build inputs.
+inline std::vector<uint64_t> packCodes(const std::vector<uint32_t>& codes,
+    unsigned bitWidth)
+{
+    std::vector<uint64_t> words((codes.size() * bitWidth + 63) / 64 + 1, 0);
+    for (size_t i = 0; i < codes.size(); ++i)
+    {
+        const auto bit = i * bitWidth;
+        const auto shift = bit % 64;
+        words[bit / 64] |= uint64_t{codes[i]} << shift;
+        if (shift + bitWidth > 64)
+        {
+            words[bit / 64 + 1] |= uint64_t{codes[i]} >> (64 - shift);
+        }
+    }
+    return words;
+}
+
+
+// Codes are unpacked in blocks of this many, a size that keeps the buffer
+// in L1 and gives the compiler a fixed trip count to unroll.
+constexpr size_t kUnpackBlock = 256;
+
+
+// Unpacks codes [begin, begin + count) into "out".
+inline void unpackCodes(const PackedCodes& packed, size_t begin, size_t count,
+    uint32_t* out)
+{
+    const uint64_t mask = (uint64_t{1} << packed.bitWidth) - 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto bit = (begin + i) * packed.bitWidth;
+        const auto word = bit / 64;
+        const auto shift = bit % 64;
+        auto code = packed.words[word] >> shift;
+        if (shift + packed.bitWidth > 64)
+        {
+            code |= packed.words[word + 1] << (64 - shift);
+        }
+        out[i] = static_cast<uint32_t>(code & mask);
+    }
+}
+
+
+// Occurrence count of every code. Threads histogram separate parts of the
+// stream; within a thread, four interleaved histograms keep runs of equal
+// codes from serializing on a single counter.
+inline std::vector<size_t> codeHistogram(const PackedCodes& packed, size_t codes)
+{
+    const auto blocks = (packed.size + kUnpackBlock - 1) / kUnpackBlock;
+    std::vector<std::vector<size_t> > partial(workerCount(blocks),
+        std::vector<size_t>(4 * codes, 0));
+
+    parallelFor(blocks, [&](size_t begin, size_t end, size_t worker)
+    {
+        auto& histogram = partial[worker];
+        uint32_t buffer[kUnpackBlock];
+        for (size_t block = begin; block < end; ++block)
+        {
+            const auto first = block * kUnpackBlock;
+            const auto count = std::min(kUnpackBlock, packed.size - first);
+            unpackCodes(packed, first, count, buffer);
+            for (size_t i = 0; i < count; ++i)
+            {
+                ++histogram[(i % 4) * codes + buffer[i]];
+            }
+        }
+    });
+
+    std::vector<size_t> histogram(codes, 0);
+    for (const auto& counts : partial)
+    {
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            for (size_t code = 0; code < codes; ++code)
+            {
+                histogram[code] += counts[lane * codes + code];
+            }
+        }
+    }
+    return histogram;
+}
+
+
+// Median of a dictionary-encoded column. "dictionary" maps codes to
+// distinct values and need not be sorted; every code must be smaller than
+// its size. Returned indices are row numbers.
+inline MedianResult dictionaryMedian(const std::vector<double>& dictionary,
+    const PackedCodes& packed)
+{
+    const auto ranks = middleRanks(packed.size);
+    if (ranks.empty() || dictionary.empty())
+    {
+        return emptyMedianResult();
+    }
+
+    const auto histogram = codeHistogram(packed, dictionary.size());
+    std::vector<uint32_t> byValue(dictionary.size());
+    std::iota(byValue.begin(), byValue.end(), 0u);
+    std::sort(byValue.begin(), byValue.end(),
+        [&](auto a, auto b) { return dictionary[a] < dictionary[b]; });
+
+    // The code holding each middle rank and the occurrence of that code.
+    std::vector<uint32_t> targetCodes;
+    std::vector<size_t> occurrences;
+    size_t seen = 0;
+    auto code = byValue.begin();
+    for (const auto rank : ranks)
+    {
+        while (seen + histogram[*code] <= rank)
+        {
+            seen += histogram[*code];
+            ++code;
+        }
+        targetCodes.push_back(*code);
+        occurrences.push_back(rank - seen);
+    }
+
+    // One more pass over the packed stream, stopping as soon as the row of
+    // every target occurrence is known.
+    std::vector<size_t> rows(ranks.size(), packed.size);
+    std::vector<size_t> counts(ranks.size(), 0);
+    uint32_t buffer[kUnpackBlock];
+    size_t found = 0;
+    for (size_t first = 0; first < packed.size && found < rows.size(); first += kUnpackBlock)
+    {
+        const auto count = std::min(kUnpackBlock, packed.size - first);
+        unpackCodes(packed, first, count, buffer);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t t = 0; t < targetCodes.size(); ++t)
+            {
+                if (buffer[i] == targetCodes[t] && counts[t]++ == occurrences[t])
+                {
+                    rows[t] = first + i;
+                    ++found;
+                }
+            }
+        }
+    }
+
+    double sum = 0.0;
+    for (const auto target : targetCodes)
+    {
+        sum += dictionary[target];
+    }
+    return std::make_tuple(sum / rows.size(), rows);
+}
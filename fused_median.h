@@ -0,0 +1,114 @@
+// Median of filtered and transformed data without temporaries.
+//
+// "Take the median of the transformed values that pass a filter" usually
+// means an intermediate vector per stage. Here the stages run inside the
+// pass that builds the selection scratch, so the data is read exactly once
+// and the indices still refer to the underlying, unfiltered array.
+//
+// fusedMedian takes the filter and the transform as callables and works
+// with any standard. When the library has C++20 ranges, rangeMedian also
+// accepts a view such as data | std::views::filter(...) |
+// std::views::transform(...) and recovers underlying indices from the
+// views' base iterators.
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+#if defined(__cpp_lib_ranges)
+#include <ranges>
+#endif
+
+
+// Median of transform(data[i]) over the elements for which keep(data[i])
+// holds, in a single pass. Indices refer to "data".
+template<typename T, typename Keep, typename Transform>
+MedianResult fusedMedian(const std::vector<T>& data, Keep keep, Transform transform)
+{
+    std::vector<std::pair<size_t, double> > scratch;
+    for (size_t index = 0; index < data.size(); ++index)
+    {
+        if (std::invoke(keep, data[index]))
+        {
+            scratch.emplace_back(index,
+                static_cast<double>(std::invoke(transform, data[index])));
+        }
+    }
+    return selectMedian(scratch);
+}
+
+
+#if defined(__cpp_lib_ranges)
+
+// The innermost range of a chain of views: each adaptor exposes the range
+// it adapts through base(), down to the container itself.
+template<typename Range>
+decltype(auto) innermostRange(Range&& range)
+{
+    if constexpr (requires { range.base(); })
+    {
+        return innermostRange(range.base());
+    }
+    else
+    {
+        return std::forward<Range>(range);
+    }
+}
+
+
+template<typename Iterator>
+struct IsReverseIterator : std::false_type {};
+
+template<typename Iterator>
+struct IsReverseIterator<std::reverse_iterator<Iterator> > : std::true_type {};
+
+
+// Unwraps a view iterator through base() until it has the innermost
+// range's iterator type. A reverse iterator's base() is one past the
+// element it refers to.
+template<typename Target, typename Iterator>
+Target innermostIterator(const Iterator& iterator)
+{
+    if constexpr (std::is_same_v<Iterator, Target>)
+    {
+        return iterator;
+    }
+    else if constexpr (IsReverseIterator<Iterator>::value)
+    {
+        return innermostIterator<Target>(std::prev(iterator.base()));
+    }
+    else
+    {
+        static_assert(requires { iterator.base(); },
+            "rangeMedian supports views whose iterators expose base()");
+        return innermostIterator<Target>(iterator.base());
+    }
+}
+
+
+// Median of a view over a random-access container, filled in the single
+// pass that walks the view. Indices are positions in the container.
+template<std::ranges::viewable_range Range>
+MedianResult rangeMedian(Range&& range)
+{
+    auto&& view = std::views::all(std::forward<Range>(range));
+    auto&& underlying = innermostRange(view);
+    const auto origin = std::ranges::begin(underlying);
+    using Origin = std::remove_cvref_t<decltype(origin)>;
+
+    std::vector<std::pair<size_t, double> > scratch;
+    for (auto it = std::ranges::begin(view); it != std::ranges::end(view); ++it)
+    {
+        const auto position = innermostIterator<Origin>(it) - origin;
+        scratch.emplace_back(static_cast<size_t>(position), static_cast<double>(*it));
+    }
+    return selectMedian(scratch);
+}
+
+#endif
@@ -0,0 +1,53 @@
+// Batched medians over index subsets of one base array.
+//
+// Subsets are given in CSR form: the indices of subset s are
+// indices[offsets[s] .. offsets[s + 1]). Subsets are spread over worker
+// threads; each worker gathers the values of a subset into its own
+// scratch, prefetching a few elements ahead because the indices (e.g.
+// graph neighbours) usually jump around the base array, and then selects
+// the median in place.
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// How many elements ahead of the current one the gather prefetches.
+constexpr size_t kGatherPrefetchDistance = 16;
+
+
+// Median of every subset of "base" listed in CSR form. Returned indices
+// refer to the base array; empty subsets give NaN and no indices.
+inline std::vector<MedianResult> gatherMedians(const std::vector<double>& base,
+    const std::vector<size_t>& offsets, const std::vector<size_t>& indices)
+{
+    const auto subsets = offsets.empty() ? 0 : offsets.size() - 1;
+    std::vector<MedianResult> results(subsets);
+    std::vector<std::vector<std::pair<size_t, double> > > workspaces(workerCount(subsets));
+
+    parallelFor(subsets, [&](size_t begin, size_t end, size_t worker)
+    {
+        auto& scratch = workspaces[worker];
+        for (size_t subset = begin; subset < end; ++subset)
+        {
+            const auto first = offsets[subset];
+            const auto last = offsets[subset + 1];
+            scratch.resize(last - first);
+            for (size_t i = first; i < last; ++i)
+            {
+                if (i + kGatherPrefetchDistance < last)
+                {
+                    __builtin_prefetch(&base[indices[i + kGatherPrefetchDistance]]);
+                }
+                scratch[i - first] = std::make_pair(indices[i], base[indices[i]]);
+            }
+            results[subset] = selectMedian(scratch);
+        }
+    });
+    return results;
+}
@@ -0,0 +1,174 @@
+// Hampel filter: rolling robust outlier detection.
+//
+// A point is an outlier when it is further than "threshold" scaled MADs
+// from the median of the window centred on it. Both statistics come from
+// one sorted sliding window that is updated by a single insert and erase
+// per step: the median is read off the middle, and the MAD is the k-th
+// smallest distance to it, found by binary search over the two sorted
+// runs of distances on either side of the median. Nothing is re-selected.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// Consistency constant that makes the MAD estimate the standard deviation
+// of normally distributed data.
+constexpr double kMadToSigma = 1.4826;
+
+
+// The values of a sliding window kept in sorted order.
+class SortedWindow
+{
+public:
+    void insert(double value)
+    {
+        sorted_.insert(std::upper_bound(sorted_.begin(), sorted_.end(), value), value);
+    }
+
+    void erase(double value)
+    {
+        sorted_.erase(std::lower_bound(sorted_.begin(), sorted_.end(), value));
+    }
+
+    double median() const
+    {
+        const auto ranks = middleRanks(sorted_.size());
+        double sum = 0.0;
+        for (const auto rank : ranks)
+        {
+            sum += sorted_[rank];
+        }
+        return sum / ranks.size();
+    }
+
+    // Median absolute deviation from the given median.
+    double mad(double median) const
+    {
+        const auto ranks = middleRanks(sorted_.size());
+        double sum = 0.0;
+        for (const auto rank : ranks)
+        {
+            sum += distanceOfRank(median, rank);
+        }
+        return sum / ranks.size();
+    }
+
+private:
+    // The rank-th smallest |value - median|. Distances grow away from the
+    // median on both sides, so they form two sorted runs and the answer
+    // is found by binary search on how many come from the lower run.
+    double distanceOfRank(double median, size_t rank) const
+    {
+        const size_t split = std::lower_bound(
+            sorted_.begin(), sorted_.end(), median) - sorted_.begin();
+        const auto lowerSize = split;
+        const auto upperSize = sorted_.size() - split;
+        const auto lower = [&](size_t i) { return median - sorted_[split - 1 - i]; };
+        const auto upper = [&](size_t i) { return sorted_[split + i] - median; };
+
+        const auto needed = rank + 1;
+        size_t lo = needed > upperSize ? needed - upperSize : 0;
+        size_t hi = std::min(needed, lowerSize);
+        while (lo < hi)
+        {
+            const auto i = lo + (hi - lo) / 2;
+            if (upper(needed - i - 1) > lower(i))
+            {
+                lo = i + 1;
+            }
+            else
+            {
+                hi = i;
+            }
+        }
+        const auto fromUpper = needed - lo;
+        return std::max(
+            lo > 0 ? lower(lo - 1) : 0.0,
+            fromUpper > 0 ? upper(fromUpper - 1) : 0.0);
+    }
+
+    std::vector<double> sorted_;
+};
+
+
+// Runs a Hampel filter with windows of 2 * halfWindow + 1 points over a
+// series, truncated at both ends. Returns the indices of outliers and the
+// rolling medians; outliers are replaced by their medians if "replace".
+inline std::tuple<std::vector<size_t>, std::vector<double> > hampelFilter(
+    std::vector<double>& series, size_t halfWindow, double threshold = 3.0,
+    bool replace = false)
+{
+    const auto size = series.size();
+    std::vector<size_t> outliers;
+    std::vector<double> medians(size);
+
+    // Replacement overwrites the series, so the window keeps the original
+    // values of the points it may still have to erase in a ring buffer.
+    const auto windowSize = 2 * halfWindow + 1;
+    std::vector<double> originals(windowSize);
+
+    SortedWindow window;
+    size_t added = 0;
+    const auto add = [&]()
+    {
+        originals[added % windowSize] = series[added];
+        window.insert(series[added]);
+        ++added;
+    };
+    while (added < std::min(size, halfWindow))
+    {
+        add();
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        // Erase before adding: the entering point reuses the ring slot of
+        // the leaving one.
+        if (i > halfWindow)
+        {
+            window.erase(originals[(i - halfWindow - 1) % windowSize]);
+        }
+        if (added < size)
+        {
+            add();
+        }
+
+        const auto median = window.median();
+        const auto scale = kMadToSigma * window.mad(median);
+        medians[i] = median;
+        if (std::abs(series[i] - median) > threshold * scale)
+        {
+            outliers.push_back(i);
+            if (replace)
+            {
+                series[i] = median;
+            }
+        }
+    }
+    return std::make_tuple(outliers, medians);
+}
+
+
+// Hampel filter over several series at once, one series per task.
+inline std::vector<std::tuple<std::vector<size_t>, std::vector<double> > > hampelFilter(
+    std::vector<std::vector<double> >& series, size_t halfWindow,
+    double threshold = 3.0, bool replace = false)
+{
+    std::vector<std::tuple<std::vector<size_t>, std::vector<double> > > results(series.size());
+    parallelFor(series.size(), [&](size_t begin, size_t end, size_t)
+    {
+        for (size_t s = begin; s < end; ++s)
+        {
+            results[s] = hampelFilter(series[s], halfWindow, threshold, replace);
+        }
+    });
+    return results;
+}
@@ -0,0 +1,120 @@
+// Median with lazily recovered indices.
+//
+// Most callers read only the median value. The value alone can be selected
+// on a plain copy of the doubles, half the memory traffic of pairing every
+// element with its index. The indices are recovered only when they are
+// first read, by scanning the input for the central value(s). The result
+// is still a tuple, so "const auto [median_value, indices]" works as usual.
+
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Indices of the median element(s), computed on first access by an
+// equality scan over the input. The input must outlive that first access.
+// Among equal values the lowest indices are reported. Not safe to read
+// for the first time from several threads at once.
+class LazyIndices
+{
+public:
+    LazyIndices(const double* data, size_t size, std::vector<double> targets) :
+        data_(data), size_(size), targets_(std::move(targets)) {}
+
+    const std::vector<size_t>& get() const
+    {
+        if (!ready_)
+        {
+            recover();
+            ready_ = true;
+        }
+        return indices_;
+    }
+
+    operator const std::vector<size_t>&() const { return get(); }
+
+    auto begin() const { return get().begin(); }
+    auto end() const { return get().end(); }
+    size_t size() const { return get().size(); }
+    size_t operator[](size_t i) const { return get()[i]; }
+
+private:
+    // Scans in blocks: a block is first checked with a branch-free count
+    // of matches, which vectorizes, and only searched element by element
+    // when it contains one.
+    void recover() const
+    {
+        constexpr size_t block = 64;
+        std::vector<size_t> found(targets_.size(), size_);
+        size_t missing = targets_.size();
+        for (size_t first = 0; first < size_ && missing > 0; first += block)
+        {
+            const auto last = std::min(size_, first + block);
+            for (size_t t = 0; t < targets_.size(); ++t)
+            {
+                if (found[t] != size_)
+                {
+                    continue;
+                }
+                size_t matches = 0;
+                for (size_t i = first; i < last; ++i)
+                {
+                    matches += data_[i] == targets_[t];
+                }
+                for (size_t i = first; matches > 0 && i < last; ++i)
+                {
+                    // Equal targets take distinct occurrences.
+                    const auto taken = t > 0 && found[t - 1] == i;
+                    if (data_[i] == targets_[t] && !taken)
+                    {
+                        found[t] = i;
+                        --missing;
+                        break;
+                    }
+                }
+            }
+        }
+        indices_ = found;
+    }
+
+    const double* data_;
+    size_t size_;
+    std::vector<double> targets_;
+    mutable bool ready_ = false;
+    mutable std::vector<size_t> indices_;
+};
+
+
+// Median value selected on a copy of the plain values, with indices that
+// are only computed if they are read.
+inline std::tuple<double, LazyIndices> lazyMedian(const std::vector<double>& elements)
+{
+    const auto size = elements.size();
+    if (size == 0)
+    {
+        return std::make_tuple(std::get<0>(emptyMedianResult()),
+            LazyIndices(elements.data(), 0, {}));
+    }
+
+    std::vector<double> values(elements);
+    const auto upper = values.begin() + size / 2;
+    std::nth_element(values.begin(), upper, values.end());
+    std::vector<double> targets {*upper};
+    if (size % 2 == 0)
+    {
+        targets.insert(targets.begin(), *std::max_element(values.begin(), upper));
+    }
+
+    const auto value = (targets.front() + targets.back()) / 2;
+    return std::make_tuple(value, LazyIndices(elements.data(), size, targets));
+}
+
+
+// The indices would scan a temporary that is gone by the time they are
+// read, so temporaries are rejected at compile time.
+std::tuple<double, LazyIndices> lazyMedian(std::vector<double>&& elements) = delete;
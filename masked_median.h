@@ -0,0 +1,82 @@
+// Median of a column with a validity (null) bitmap.
+//
+// The bitmap is packed least significant bit first, eight values per byte,
+// a set bit marking a valid value (the Arrow layout). Instead of building
+// a filtered copy and then enumerating it, the valid (index, value) pairs
+// are compacted straight into the selection scratch in the first pass:
+// a word of 64 validity bits is handled at once, fully valid words are
+// copied as a block, and otherwise only the set bits are visited.
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Median of the valid values among values[0, size). Returned indices
+// refer to the original, unfiltered array. A null bitmap means that
+// every value is valid.
+inline MedianResult maskedMedian(const double* values, size_t size,
+    const uint8_t* validity)
+{
+    std::vector<std::pair<size_t, double> > compacted;
+    compacted.reserve(size);
+
+    const auto words = size / 64;
+    for (size_t word = 0; word < words; ++word)
+    {
+        const auto base = word * 64;
+        uint64_t bits = ~uint64_t{0};
+        if (validity != nullptr)
+        {
+            // Assembled byte by byte, so this is independent of endianness.
+            bits = 0;
+            for (size_t byte = 0; byte < 8; ++byte)
+            {
+                bits |= uint64_t{validity[word * 8 + byte]} << (8 * byte);
+            }
+        }
+
+        if (bits == ~uint64_t{0})
+        {
+            for (size_t i = 0; i < 64; ++i)
+            {
+                compacted.emplace_back(base + i, values[base + i]);
+            }
+            continue;
+        }
+        while (bits != 0)
+        {
+            const auto i = static_cast<size_t>(__builtin_ctzll(bits));
+            compacted.emplace_back(base + i, values[base + i]);
+            bits &= bits - 1;
+        }
+    }
+    for (size_t index = words * 64; index < size; ++index)
+    {
+        if (validity == nullptr || (validity[index / 8] >> (index % 8)) & 1)
+        {
+            compacted.emplace_back(index, values[index]);
+        }
+    }
+
+    return selectMedian(compacted);
+}
+
+
+// Median of the valid elements of a vector, see above. An empty bitmap
+// means that every value is valid; otherwise it must cover every element.
+inline MedianResult maskedMedian(const std::vector<double>& elements,
+    const std::vector<uint8_t>& validity)
+{
+    if (!validity.empty() && validity.size() < (elements.size() + 7) / 8)
+    {
+        throw std::invalid_argument("maskedMedian: validity bitmap shorter than the values");
+    }
+    return maskedMedian(elements.data(), elements.size(),
+        validity.empty() ? nullptr : validity.data());
+}
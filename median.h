@@ -0,0 +1,131 @@
+// Shared building blocks for the median routines in this repository.
+//
+// Every routine returns its answer in the same shape as the lambda in
+// structured_bindings.cpp: a median value together with the original
+// indices of the element(s) it was computed from, so that callers can
+// keep unpacking results into const structured bindings.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+// The result of a median query: the value and the original indices
+// of the one (odd size) or two (even size) central elements.
+using MedianResult = std::tuple<double, std::vector<size_t>>;
+
+
+// A result for an empty input: NaN and no indices.
+inline MedianResult emptyMedianResult()
+{
+    return std::make_tuple(
+        std::numeric_limits<double>::quiet_NaN(),
+        std::vector<size_t>());
+}
+
+
+// Ranks (0-based positions in sorted order) of the central element(s)
+// of a sequence of the given size. Empty for an empty sequence.
+template<typename Size>
+std::vector<Size> middleRanks(Size size)
+{
+    if (size == 0)
+    {
+        return {};
+    }
+    return (size % 2 == 0) ?
+        std::vector<Size>{size / 2 - 1, size / 2} :
+        std::vector<Size>{size / 2};
+}
+
+
+// Selects the median of (original index, value) pairs in expected linear
+// time. The pairs are reordered in place, which lets callers keep one
+// workspace around and refill it for every query.
+template<typename Value>
+MedianResult selectMedian(std::vector<std::pair<size_t, Value> >& enumerated)
+{
+    if (enumerated.empty())
+    {
+        return emptyMedianResult();
+    }
+
+    const auto byValue = [](const auto& a, const auto& b)
+        { return a.second < b.second; };
+
+    const auto ranks = middleRanks(enumerated.size());
+    const auto upper = enumerated.begin() + ranks.back();
+    std::nth_element(enumerated.begin(), upper, enumerated.end(), byValue);
+
+    std::vector<size_t> originalIndices;
+    double sum = 0.0;
+    if (ranks.size() == 2)
+    {
+        // After nth_element everything in front of "upper" is not greater
+        // than it, so the lower central element is the largest of those.
+        const auto lower = std::max_element(enumerated.begin(), upper, byValue);
+        originalIndices.push_back(lower->first);
+        sum += static_cast<double>(lower->second);
+    }
+    originalIndices.push_back(upper->first);
+    sum += static_cast<double>(upper->second);
+
+    return std::make_tuple(sum / originalIndices.size(), originalIndices);
+}
+
+
+// Median of a range of plain values, reordering it in place. Meant for
+// callers that only need the value and keep a scratch buffer around.
+inline double medianInPlace(double* begin, double* end)
+{
+    const auto size = static_cast<size_t>(end - begin);
+    if (size == 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    const auto upper = begin + size / 2;
+    std::nth_element(begin, upper, end);
+    if (size % 2 == 1)
+    {
+        return *upper;
+    }
+    return (*std::max_element(begin, upper) + *upper) / 2;
+}
+
+
+// Median of a vector with the original indices of its central element(s),
+// the same answer as the lambda in structured_bindings.cpp but selected in
+// expected linear time instead of sorted.
+inline MedianResult median(const std::vector<double>& elements)
+{
+    std::vector<std::pair<size_t, double> > enumerated;
+    enumerated.reserve(elements.size());
+    for (size_t index = 0; index < elements.size(); ++index)
+    {
+        enumerated.emplace_back(index, elements[index]);
+    }
+    return selectMedian(enumerated);
+}
+
+
+// Median of a projected key of records, e.g. median(records, &Record::latency)
+// or a lambda. The keys are extracted once into a compact (index, key)
+// scratch, so selection moves 16-byte pairs instead of whole records and
+// never touches the records again. Indices refer to the records.
+template<typename Record, typename Projection>
+MedianResult median(const std::vector<Record>& records, Projection projection)
+{
+    std::vector<std::pair<size_t, double> > keys;
+    keys.reserve(records.size());
+    for (size_t index = 0; index < records.size(); ++index)
+    {
+        keys.emplace_back(index,
+            static_cast<double>(std::invoke(projection, records[index])));
+    }
+    return selectMedian(keys);
+}
@@ -0,0 +1,303 @@
+// Implementation of the C interface declared in median_c.h.
+//
+// Selection works on (index, value) entries laid out in the caller's
+// workspace, or in a vector when there is none. Exceptions are caught at
+// the boundary and turned into status codes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "median_c.h"
+#include "parallel.h"
+
+
+namespace
+{
+
+using Entry = std::pair<size_t, double>;
+
+const auto kNaN = std::numeric_limits<double>::quiet_NaN();
+
+
+// Fills "entries" from data[0, size); false if there is a NaN, which has
+// no place in the order.
+bool enumerate(const double* data, size_t size, Entry* entries)
+{
+    bool valid = true;
+    for (size_t index = 0; index < size; ++index)
+    {
+        valid &= !std::isnan(data[index]);
+        entries[index] = Entry(index, data[index]);
+    }
+    return valid;
+}
+
+
+bool byValue(const Entry& a, const Entry& b)
+{
+    return a.second < b.second;
+}
+
+
+// Median of entries[0, size), non-empty; positions are written to
+// "indices" (offset by "base") when it is not null.
+double selectCentral(Entry* entries, size_t size, size_t base,
+    size_t* indices, size_t* indexCount)
+{
+    const auto upper = entries + size / 2;
+    std::nth_element(entries, upper, entries + size, byValue);
+    auto lower = upper;
+    if (size % 2 == 0)
+    {
+        lower = std::max_element(entries, upper, byValue);
+    }
+
+    if (indices != nullptr)
+    {
+        indices[0] = base + lower->first;
+        if (lower != upper)
+        {
+            indices[1] = base + upper->first;
+        }
+    }
+    if (indexCount != nullptr)
+    {
+        *indexCount = lower == upper ? 1 : 2;
+    }
+    return (lower->second + upper->second) / 2;
+}
+
+
+// Entries for "size" elements in the caller's workspace, or in "owned".
+// Null if the workspace is given but unusable.
+Entry* entriesFor(size_t size, void* workspace, size_t workspaceSize,
+    std::vector<Entry>& owned)
+{
+    if (workspace == nullptr)
+    {
+        owned.resize(size);
+        return owned.data();
+    }
+    const auto aligned = reinterpret_cast<uintptr_t>(workspace) % alignof(Entry) == 0;
+    if (!aligned || workspaceSize < size * sizeof(Entry))
+    {
+        return nullptr;
+    }
+    return static_cast<Entry*>(workspace);
+}
+
+
+template<typename Func>
+median_status guarded(Func&& func)
+{
+    try
+    {
+        return func();
+    }
+    catch (const std::bad_alloc&)
+    {
+        return MEDIAN_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return MEDIAN_INTERNAL_ERROR;
+    }
+}
+
+}
+
+
+extern "C"
+{
+
+int median_abi_version(void)
+{
+    return MEDIAN_ABI_VERSION;
+}
+
+
+size_t median_workspace_size(size_t size)
+{
+    return size * sizeof(Entry);
+}
+
+
+median_status median_f64(const double* data, size_t size,
+    void* workspace, size_t workspace_size,
+    double* median, size_t* indices, size_t* index_count)
+{
+    return guarded([&]()
+    {
+        if (median == nullptr || (data == nullptr && size > 0))
+        {
+            return MEDIAN_INVALID_ARGUMENT;
+        }
+        *median = kNaN;
+        if (index_count != nullptr)
+        {
+            *index_count = 0;
+        }
+        if (size == 0)
+        {
+            return MEDIAN_EMPTY;
+        }
+
+        std::vector<Entry> owned;
+        const auto entries = entriesFor(size, workspace, workspace_size, owned);
+        if (entries == nullptr || !enumerate(data, size, entries))
+        {
+            return MEDIAN_INVALID_ARGUMENT;
+        }
+        *median = selectCentral(entries, size, 0, indices, index_count);
+        return MEDIAN_OK;
+    });
+}
+
+
+median_status median_quantiles_f64(const double* data, size_t size,
+    const double* probabilities, size_t count,
+    void* workspace, size_t workspace_size, double* quantiles)
+{
+    return guarded([&]()
+    {
+        if ((data == nullptr && size > 0) ||
+            ((probabilities == nullptr || quantiles == nullptr) && count > 0))
+        {
+            return MEDIAN_INVALID_ARGUMENT;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!(probabilities[i] >= 0.0 && probabilities[i] <= 1.0))
+            {
+                return MEDIAN_INVALID_ARGUMENT;
+            }
+            quantiles[i] = kNaN;
+        }
+        if (size == 0)
+        {
+            return MEDIAN_EMPTY;
+        }
+
+        std::vector<Entry> owned;
+        const auto entries = entriesFor(size, workspace, workspace_size, owned);
+        if (entries == nullptr || !enumerate(data, size, entries))
+        {
+            return MEDIAN_INVALID_ARGUMENT;
+        }
+
+        // Every rank needed, lower and lower + 1 for each probability, is
+        // selected in increasing order, so each selection only searches the
+        // part after the previous one. The next rank is found by a pass over
+        // the probabilities instead of from a sorted list of ranks, which
+        // would have to be allocated.
+        const auto lowerRank = [&](size_t i)
+            { return static_cast<size_t>(probabilities[i] * (size - 1)); };
+        size_t first = 0;
+        while (true)
+        {
+            auto rank = size;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto lower = lowerRank(i);
+                const auto needed = lower >= first ? lower : lower + 1;
+                if (needed >= first && needed < rank)
+                {
+                    rank = needed;
+                }
+            }
+            if (rank == size)
+            {
+                break;
+            }
+            std::nth_element(entries + first, entries + rank, entries + size, byValue);
+            first = rank + 1;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto position = probabilities[i] * (size - 1);
+            const auto lower = lowerRank(i);
+            const auto fraction = position - lower;
+            const auto a = entries[lower].second;
+            const auto b = entries[std::min(lower + 1, size - 1)].second;
+            quantiles[i] = fraction == 0.0 ? a : a + fraction * (b - a);
+        }
+        return MEDIAN_OK;
+    });
+}
+
+
+median_status median_batch_f64(const double* data, const size_t* offsets,
+    size_t batch_count, double* medians, size_t* indices, size_t* index_counts)
+{
+    return guarded([&]()
+    {
+        if (batch_count == 0)
+        {
+            return MEDIAN_OK;
+        }
+        if (offsets == nullptr || medians == nullptr ||
+            (data == nullptr && offsets[batch_count] > offsets[0]))
+        {
+            return MEDIAN_INVALID_ARGUMENT;
+        }
+        for (size_t i = 0; i < batch_count; ++i)
+        {
+            if (offsets[i] > offsets[i + 1])
+            {
+                return MEDIAN_INVALID_ARGUMENT;
+            }
+        }
+
+        // Exceptions cannot leave the worker threads, so every segment
+        // records its own status and the first failure is reported.
+        std::vector<std::vector<Entry> > workspaces(workerCount(batch_count));
+        std::vector<median_status> statuses(batch_count, MEDIAN_OK);
+        parallelFor(batch_count, [&](size_t begin, size_t end, size_t worker)
+        {
+            auto& scratch = workspaces[worker];
+            for (size_t segment = begin; segment < end; ++segment)
+            {
+                const auto first = offsets[segment];
+                const auto size = offsets[segment + 1] - first;
+                auto slots = indices == nullptr ? nullptr : indices + 2 * segment;
+                auto counts = index_counts == nullptr ? nullptr : index_counts + segment;
+                medians[segment] = kNaN;
+                if (counts != nullptr)
+                {
+                    *counts = 0;
+                }
+                if (size == 0)
+                {
+                    continue;
+                }
+                statuses[segment] = guarded([&]()
+                {
+                    scratch.resize(size);
+                    if (!enumerate(data + first, size, scratch.data()))
+                    {
+                        return MEDIAN_INVALID_ARGUMENT;
+                    }
+                    medians[segment] = selectCentral(scratch.data(), size, first, slots, counts);
+                    return MEDIAN_OK;
+                });
+            }
+        });
+
+        for (const auto status : statuses)
+        {
+            if (status != MEDIAN_OK)
+            {
+                return status;
+            }
+        }
+        return MEDIAN_OK;
+    });
+}
+
+}
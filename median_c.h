@@ -0,0 +1,79 @@
+// C interface to the median routines, for use from other languages.
+//
+// Built as the shared library "median" (libmedian.so). Every function takes
+// plain pointers and lengths and writes into buffers owned by the caller,
+// so arrays from Python, Go or Rust are passed in place and no C++ object
+// or allocation ever crosses the boundary. Functions never throw; they
+// report problems through the returned status. The ABI is versioned: new
+// functions may be added, existing signatures do not change within a major
+// version.
+
+#pragma once
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(MEDIAN_BUILDING)
+#define MEDIAN_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define MEDIAN_API __declspec(dllimport)
+#else
+#define MEDIAN_API __attribute__((visibility("default")))
+#endif
+
+#define MEDIAN_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef enum
+{
+    MEDIAN_OK = 0,
+    // The input has no elements; results are NaN.
+    MEDIAN_EMPTY = 1,
+    // A null pointer where data is needed, a NaN in the input or a
+    // probability outside [0, 1], or a workspace that is too small.
+    MEDIAN_INVALID_ARGUMENT = 2,
+    MEDIAN_OUT_OF_MEMORY = 3,
+    MEDIAN_INTERNAL_ERROR = 4
+} median_status;
+
+
+// MEDIAN_ABI_VERSION of the loaded library.
+MEDIAN_API int median_abi_version(void);
+
+// Bytes of workspace that median_f64 and median_quantiles_f64 need for an
+// input of "size" elements; the workspace must be aligned to 8 bytes.
+// With a workspace these functions allocate nothing; callers that pass
+// none (NULL) let the library allocate it for the duration of the call.
+MEDIAN_API size_t median_workspace_size(size_t size);
+
+// Median of data[0, size). Writes the value to *median, the positions of
+// the one (odd size) or two (even size) central elements to indices[0..1]
+// and their number to *index_count. "indices" and "index_count" may be
+// NULL when the positions are not needed.
+MEDIAN_API median_status median_f64(const double* data, size_t size,
+    void* workspace, size_t workspace_size,
+    double* median, size_t* indices, size_t* index_count);
+
+// The quantiles of data[0, size) at probabilities[0, count), each by
+// linear interpolation between the two closest ranks, written to
+// quantiles[0, count). The probabilities need not be sorted.
+MEDIAN_API median_status median_quantiles_f64(const double* data, size_t size,
+    const double* probabilities, size_t count,
+    void* workspace, size_t workspace_size, double* quantiles);
+
+// Medians of "batch_count" consecutive segments of "data", segment i being
+// data[offsets[i], offsets[i + 1]) ("offsets" has batch_count + 1
+// entries). Segments are processed in parallel. Writes medians[i],
+// index_counts[i] and the central positions (relative to "data") to
+// indices[2 * i] and indices[2 * i + 1]; "indices" and "index_counts" may
+// be NULL. Empty segments give NaN and no indices but are not an error.
+MEDIAN_API median_status median_batch_f64(const double* data, const size_t* offsets,
+    size_t batch_count, double* medians, size_t* indices, size_t* index_counts);
+
+
+#ifdef __cplusplus
+}
+#endif
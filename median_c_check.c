@@ -0,0 +1,142 @@
+// Checks the C interface (median_c.h) from C99: every function on a small
+// input, with and without a workspace, and the statuses for empty input,
+// NaN, probabilities outside [0, 1] and unusable workspaces.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "median_c.h"
+
+
+static int failures = 0;
+
+
+static int byValue(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+static void check(int ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s failed\n", what);
+        ++failures;
+    }
+}
+
+
+int main(void)
+{
+    const double data[] = {5, 1, 4, 2, 3, 6};
+    const size_t size = sizeof(data) / sizeof(data[0]);
+    uint64_t workspace[32];
+    double median = 0.0;
+    size_t indices[2] = {0, 0};
+    size_t indexCount = 0;
+
+    check(median_abi_version() == MEDIAN_ABI_VERSION, "median_abi_version");
+    check(median_workspace_size(size) <= sizeof(workspace), "median_workspace_size");
+
+    // median_f64: allocated and caller-provided workspace.
+    check(median_f64(data, size, NULL, 0, &median, indices, &indexCount) == MEDIAN_OK &&
+        median == 3.5 && indexCount == 2 && indices[0] == 4 && indices[1] == 2,
+        "median_f64");
+    check(median_f64(data, size, workspace, sizeof(workspace), &median, NULL, NULL) ==
+        MEDIAN_OK && median == 3.5, "median_f64 with workspace");
+    check(median_f64(data, 0, NULL, 0, &median, indices, &indexCount) == MEDIAN_EMPTY &&
+        isnan(median) && indexCount == 0, "median_f64 empty");
+    {
+        const double withNaN[] = {1, NAN, 3};
+        check(median_f64(withNaN, 3, NULL, 0, &median, NULL, NULL) ==
+            MEDIAN_INVALID_ARGUMENT, "median_f64 NaN");
+    }
+    check(median_f64(data, size, workspace, median_workspace_size(size) - 1, &median,
+        NULL, NULL) == MEDIAN_INVALID_ARGUMENT, "median_f64 small workspace");
+    check(median_f64(data, size, (char*)workspace + 1, sizeof(workspace) - 8, &median,
+        NULL, NULL) == MEDIAN_INVALID_ARGUMENT, "median_f64 misaligned workspace");
+
+    // median_quantiles_f64: unsorted probabilities, repeated ranks.
+    {
+        const double probabilities[] = {0.0, 0.25, 0.5, 1.0, 0.9, 0.25};
+        const double expected[] = {1.0, 2.25, 3.5, 6.0, 5.5, 2.25};
+        double quantiles[6];
+        size_t i;
+        int ok = median_quantiles_f64(data, size, probabilities, 6,
+            workspace, sizeof(workspace), quantiles) == MEDIAN_OK;
+        for (i = 0; i < 6; ++i)
+        {
+            ok = ok && fabs(quantiles[i] - expected[i]) < 1e-12;
+        }
+        check(ok, "median_quantiles_f64");
+        check(median_quantiles_f64(data, size, probabilities, 6, NULL, 0, quantiles) ==
+            MEDIAN_OK && quantiles[3] == 6.0, "median_quantiles_f64 allocated");
+        check(median_quantiles_f64(data, 0, probabilities, 6, NULL, 0, quantiles) ==
+            MEDIAN_EMPTY && isnan(quantiles[0]), "median_quantiles_f64 empty");
+    }
+    {
+        // Ranks far apart and neighbouring ones, against a sorted copy.
+        const double probabilities[] = {0.9, 0.1, 0.5, 0.11, 0.37, 0.12, 0.0, 1.0};
+        double values[100];
+        double sorted[100];
+        double quantiles[8];
+        uint64_t large[200];
+        unsigned state = 12345;
+        size_t i;
+        int ok;
+        for (i = 0; i < 100; ++i)
+        {
+            state = state * 1103515245u + 12345u;
+            values[i] = sorted[i] = (double)((state >> 16) % 1000);
+        }
+        qsort(sorted, 100, sizeof(double), byValue);
+        ok = median_quantiles_f64(values, 100, probabilities, 8,
+            large, sizeof(large), quantiles) == MEDIAN_OK;
+        for (i = 0; i < 8; ++i)
+        {
+            const double position = probabilities[i] * 99;
+            const size_t lower = (size_t)position;
+            const double b = sorted[lower < 99 ? lower + 1 : 99];
+            ok = ok && fabs(quantiles[i] -
+                (sorted[lower] + (position - lower) * (b - sorted[lower]))) < 1e-12;
+        }
+        check(ok, "median_quantiles_f64 many ranks");
+    }
+    {
+        const double outside[] = {0.5, 1.5};
+        const double notANumber[] = {NAN};
+        double quantiles[2];
+        check(median_quantiles_f64(data, size, outside, 2, NULL, 0, quantiles) ==
+            MEDIAN_INVALID_ARGUMENT, "median_quantiles_f64 probability above 1");
+        check(median_quantiles_f64(data, size, notANumber, 1, NULL, 0, quantiles) ==
+            MEDIAN_INVALID_ARGUMENT, "median_quantiles_f64 NaN probability");
+        check(median_quantiles_f64(data, size, outside, 1, workspace, 8, quantiles) ==
+            MEDIAN_INVALID_ARGUMENT, "median_quantiles_f64 small workspace");
+    }
+
+    // median_batch_f64: an empty segment is not an error, a NaN is.
+    {
+        const double values[] = {3, 1, 2, 9, 7, 8, 4};
+        const size_t offsets[] = {0, 3, 3, 7};
+        double medians[3];
+        size_t batchIndices[6];
+        size_t counts[3];
+        check(median_batch_f64(values, offsets, 3, medians, batchIndices, counts) ==
+            MEDIAN_OK && medians[0] == 2 && counts[0] == 1 && batchIndices[0] == 2 &&
+            isnan(medians[1]) && counts[1] == 0 &&
+            medians[2] == 7.5 && counts[2] == 2, "median_batch_f64");
+
+        const double withNaN[] = {3, 1, 2, NAN};
+        const size_t nanOffsets[] = {0, 3, 4};
+        check(median_batch_f64(withNaN, nanOffsets, 2, medians, NULL, NULL) ==
+            MEDIAN_INVALID_ARGUMENT && medians[0] == 2, "median_batch_f64 NaN");
+    }
+
+    printf("%s\n", failures == 0 ? "C interface checks passed" : "C interface checks failed");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
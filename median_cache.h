@@ -0,0 +1,188 @@
+// Content-addressed cache for repeated median requests.
+//
+// Dashboards ask for the median of the same array many times a minute.
+// The cache keys results by a 64-bit xxHash of the input bytes combined
+// with the length and a caller-chosen options word, so a repeated request
+// costs one hashing pass instead of a selection. Entries are evicted in
+// least-recently-used order once their total size exceeds a byte budget.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// XXH64 of a byte range, as specified by the reference xxHash.
+inline uint64_t xxHash64(const void* data, size_t size, uint64_t seed = 0)
+{
+    constexpr uint64_t prime1 = 11400714785074694791ull;
+    constexpr uint64_t prime2 = 14029467366897019727ull;
+    constexpr uint64_t prime3 = 1609587929392839161ull;
+    constexpr uint64_t prime4 = 9650029242287828579ull;
+    constexpr uint64_t prime5 = 2870177450012600261ull;
+
+    const auto rotate = [](uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); };
+    const auto round = [&](uint64_t accumulator, uint64_t input)
+        { return rotate(accumulator + input * prime2, 31) * prime1; };
+    const auto merge = [&](uint64_t hash, uint64_t accumulator)
+        { return (hash ^ round(0, accumulator)) * prime1 + prime4; };
+    const auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+    const auto read32 = [](const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; };
+
+    const auto* p = static_cast<const uint8_t*>(data);
+    const auto* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        // Four independent lanes over 32-byte stripes, which the CPU can
+        // execute in parallel.
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        hash = rotate(v1, 1) + rotate(v2, 7) + rotate(v3, 12) + rotate(v4, 18);
+        hash = merge(merge(merge(merge(hash, v1), v2), v3), v4);
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    hash += size;
+    for (; p + 8 <= end; p += 8)
+    {
+        hash = rotate(hash ^ round(0, read64(p)), 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end)
+    {
+        hash = rotate(hash ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash = rotate(hash ^ (*p * prime5), 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+// A bounded LRU cache of median results keyed by input content. Safe to
+// share between threads. Keys are 64-bit hashes, so two different inputs
+// of the same length and options are confused with probability ~2^-64.
+class MedianCache
+{
+public:
+    explicit MedianCache(size_t byteBudget) : byteBudget_(byteBudget) {}
+
+    // Returns the cached result for these elements and options, or calls
+    // compute(elements), stores and returns its result.
+    template<typename Compute>
+    MedianResult getOrCompute(const std::vector<double>& elements, uint64_t options,
+        Compute&& compute)
+    {
+        const Key key{xxHash64(elements.data(), elements.size() * sizeof(double), options),
+            elements.size(), options};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto found = index_.find(key);
+            if (found != index_.end())
+            {
+                ++hits_;
+                entries_.splice(entries_.begin(), entries_, found->second);
+                return found->second->second;
+            }
+            ++misses_;
+        }
+
+        // Computed outside of the lock, so that a slow miss does not block
+        // hits of other threads.
+        MedianResult result = compute(elements);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.find(key) == index_.end())
+        {
+            entries_.emplace_front(key, result);
+            index_.emplace(key, entries_.begin());
+            // The stored copy, whose capacity may differ from the result's,
+            // is what evict() later subtracts.
+            bytes_ += entryBytes(entries_.front().second);
+            evict();
+        }
+        return result;
+    }
+
+    // Number of cached results, lookups answered from the cache and
+    // lookups that had to compute.
+    std::tuple<size_t, size_t, size_t> statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::make_tuple(entries_.size(), hits_, misses_);
+    }
+
+private:
+    struct Key
+    {
+        uint64_t hash;
+        size_t size;
+        uint64_t options;
+
+        bool operator==(const Key& other) const
+        {
+            return hash == other.hash && size == other.size && options == other.options;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return key.hash; }
+    };
+
+    using Entry = std::pair<Key, MedianResult>;
+
+    // Approximate memory held by one entry, list and map nodes included.
+    static size_t entryBytes(const MedianResult& result)
+    {
+        return sizeof(Entry) + 4 * sizeof(void*) +
+            std::get<1>(result).capacity() * sizeof(size_t);
+    }
+
+    void evict()
+    {
+        while (bytes_ > byteBudget_ && !entries_.empty())
+        {
+            bytes_ -= entryBytes(entries_.back().second);
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+    size_t byteBudget_;
+    size_t bytes_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> entries_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,180 @@
+// Tukey's median polish for two-way tables.
+//
+// The table is fitted as overall + row effect + column effect + residual
+// by alternately sweeping row and column medians out of it. The table is
+// a row-major buffer that is turned into residuals in place; rows are
+// swept through strided views, columns in blocks of adjacent columns, and
+// each worker thread reuses its own scratch buffers across all sweeps.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// A non-owning view over every "stride"-th element of a buffer: a row of
+// a row-major table has stride 1, a column has stride equal to the width.
+struct StridedView
+{
+    double* data;
+    size_t size;
+    size_t stride;
+
+    double& operator[](size_t i) const { return data[i * stride]; }
+};
+
+
+// The result of a median polish: overall effect, row effects, column
+// effects and the number of full (row and column) sweeps performed.
+using PolishFit = std::tuple<double, std::vector<double>, std::vector<double>, size_t>;
+
+
+// Columns are swept in blocks of this many adjacent columns, so that a
+// worker reads a short contiguous piece of every row instead of jumping
+// a full row ahead for every single element.
+constexpr size_t kPolishColumnBlock = 8;
+
+
+// Subtracts the median of every view from it and adds it to the matching
+// effect.
+template<typename ViewOf>
+void sweepViews(size_t count, ViewOf viewOf, std::vector<double>& effects,
+    std::vector<std::vector<double> >& workspaces)
+{
+    parallelFor(count, [&](size_t begin, size_t end, size_t worker)
+    {
+        auto& scratch = workspaces[worker];
+        for (size_t v = begin; v < end; ++v)
+        {
+            const auto view = viewOf(v);
+            scratch.resize(view.size);
+            for (size_t i = 0; i < view.size; ++i)
+            {
+                scratch[i] = view[i];
+            }
+            const auto median = medianInPlace(scratch.data(), scratch.data() + view.size);
+            for (size_t i = 0; i < view.size; ++i)
+            {
+                view[i] -= median;
+            }
+            effects[v] += median;
+        }
+    });
+}
+
+
+// Column sweep over a row-major table: each worker takes whole blocks of
+// adjacent columns and gathers them row by row into per-column scratch.
+inline void sweepColumns(double* table, size_t rows, size_t columns,
+    std::vector<double>& effects, std::vector<std::vector<double> >& workspaces)
+{
+    const auto blocks = (columns + kPolishColumnBlock - 1) / kPolishColumnBlock;
+    parallelFor(blocks, [&](size_t begin, size_t end, size_t worker)
+    {
+        auto& scratch = workspaces[worker];
+        scratch.resize(rows * kPolishColumnBlock);
+        for (size_t block = begin; block < end; ++block)
+        {
+            const auto first = block * kPolishColumnBlock;
+            const auto width = std::min(kPolishColumnBlock, columns - first);
+            for (size_t r = 0; r < rows; ++r)
+            {
+                const auto* row = table + r * columns + first;
+                for (size_t c = 0; c < width; ++c)
+                {
+                    scratch[c * rows + r] = row[c];
+                }
+            }
+            double medians[kPolishColumnBlock];
+            for (size_t c = 0; c < width; ++c)
+            {
+                auto* column = scratch.data() + c * rows;
+                medians[c] = medianInPlace(column, column + rows);
+                effects[first + c] += medians[c];
+            }
+            for (size_t r = 0; r < rows; ++r)
+            {
+                auto* row = table + r * columns + first;
+                for (size_t c = 0; c < width; ++c)
+                {
+                    row[c] -= medians[c];
+                }
+            }
+        }
+    });
+}
+
+
+// Moves the median of the effects into the overall effect.
+inline void centerEffects(std::vector<double>& effects, double& overall,
+    std::vector<double>& scratch)
+{
+    scratch.assign(effects.begin(), effects.end());
+    const auto median = medianInPlace(scratch.data(), scratch.data() + scratch.size());
+    for (auto& effect : effects)
+    {
+        effect -= median;
+    }
+    overall += median;
+}
+
+
+// Sum of absolute residuals of the whole table, reduced in parallel.
+inline double absoluteResidualSum(const double* table, size_t size)
+{
+    std::vector<double> partial(workerCount(size), 0.0);
+    parallelFor(size, [&](size_t begin, size_t end, size_t worker)
+    {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            sum += std::abs(table[i]);
+        }
+        partial[worker] = sum;
+    });
+    return std::accumulate(partial.begin(), partial.end(), 0.0);
+}
+
+
+// Median polish of a row-major rows x columns table, which is replaced by
+// the residuals. Sweeps stop once the sum of absolute residuals changes
+// by less than "tolerance" relative to itself, or after "maxSweeps".
+inline PolishFit medianPolish(double* table, size_t rows, size_t columns,
+    double tolerance = 0.01, size_t maxSweeps = 10)
+{
+    double overall = 0.0;
+    std::vector<double> rowEffects(rows, 0.0);
+    std::vector<double> columnEffects(columns, 0.0);
+    std::vector<std::vector<double> > workspaces(
+        std::max(workerCount(rows), workerCount(columns)));
+
+    const auto rowView = [&](size_t r)
+        { return StridedView{table + r * columns, columns, 1}; };
+
+    auto previousSum = absoluteResidualSum(table, rows * columns);
+    size_t sweeps = 0;
+    while (sweeps < maxSweeps && rows > 0 && columns > 0)
+    {
+        ++sweeps;
+        sweepViews(rows, rowView, rowEffects, workspaces);
+        centerEffects(columnEffects, overall, workspaces.front());
+        sweepColumns(table, rows, columns, columnEffects, workspaces);
+        centerEffects(rowEffects, overall, workspaces.front());
+
+        const auto sum = absoluteResidualSum(table, rows * columns);
+        const auto converged = std::abs(sum - previousSum) <= tolerance * sum;
+        previousSum = sum;
+        if (converged)
+        {
+            break;
+        }
+    }
+
+    return std::make_tuple(overall, rowEffects, columnEffects, sweeps);
+}
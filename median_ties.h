@@ -0,0 +1,225 @@
+// Median with the full set of positions tied with it.
+//
+// The selection uses three-way partitioning (less, equal, greater than the
+// pivot), so its last partition step leaves every element equal to the
+// selected value in one contiguous range. The tie set is read straight out
+// of that range instead of scanning the input once more.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Original positions of the elements tied with the median, either as a
+// sorted index list or, when that would be larger, as a bitmap with one
+// bit per input element (bit i of word i / 64). Exactly one is filled.
+struct TieSet
+{
+    size_t count = 0;
+    std::vector<size_t> indices;
+    std::vector<uint64_t> bitmap;
+
+    bool contains(size_t index) const
+    {
+        if (!bitmap.empty())
+        {
+            return (bitmap[index / 64] >> (index % 64)) & 1;
+        }
+        return std::binary_search(indices.begin(), indices.end(), index);
+    }
+
+    // The positions as a sorted list, whichever form is stored.
+    std::vector<size_t> toIndices() const
+    {
+        if (bitmap.empty())
+        {
+            return indices;
+        }
+        std::vector<size_t> result;
+        result.reserve(count);
+        for (size_t word = 0; word < bitmap.size(); ++word)
+        {
+            for (auto bits = bitmap[word]; bits != 0; bits &= bits - 1)
+            {
+                result.push_back(word * 64 + __builtin_ctzll(bits));
+            }
+        }
+        return result;
+    }
+};
+
+
+// The range of elements equal to the one of the given rank, selected with
+// std::nth_element and gathered around it by two partitions.
+template<typename Iterator>
+std::pair<Iterator, Iterator> selectEqualRangeFallback(
+    Iterator first, Iterator last, size_t rank)
+{
+    const auto nth = first + rank;
+    std::nth_element(first, nth, last,
+        [](const auto& a, const auto& b) { return a.second < b.second; });
+    const auto pivot = nth->second;
+    const auto less = std::partition(first, nth,
+        [pivot](const auto& element) { return element.second < pivot; });
+    const auto greater = std::partition(nth, last,
+        [pivot](const auto& element) { return !(pivot < element.second); });
+    return std::make_pair(less, greater);
+}
+
+
+// Median of three values.
+template<typename Value>
+Value medianOfThree(Value a, Value b, Value c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+
+// Quickselect with three-way partitioning of (index, value) pairs. Returns
+// the range of all elements equal to the one of the given rank. Like
+// introselect, it gives up after 2 log2(n) partition steps, which only
+// adversarial inputs reach, and finishes with std::nth_element.
+template<typename Iterator>
+std::pair<Iterator, Iterator> selectEqualRange(Iterator first, Iterator last, size_t rank)
+{
+    size_t depthLimit = 2;
+    for (auto size = last - first; size > 1; size /= 2)
+    {
+        depthLimit += 2;
+    }
+
+    while (true)
+    {
+        if (depthLimit-- == 0)
+        {
+            return selectEqualRangeFallback(first, last, rank);
+        }
+
+        // Median-of-three pivot value, or Tukey's ninther (the median of
+        // three medians of three) for large ranges.
+        const auto size = last - first;
+        const auto at = [first](auto offset) { return (first + offset)->second; };
+        auto pivot = medianOfThree(at(0), at(size / 2), at(size - 1));
+        if (size >= 128)
+        {
+            const auto step = size / 8;
+            pivot = medianOfThree(
+                medianOfThree(at(0), at(step), at(2 * step)),
+                medianOfThree(at(size / 2 - step), at(size / 2), at(size / 2 + step)),
+                medianOfThree(at(size - 1 - 2 * step), at(size - 1 - step), at(size - 1)));
+        }
+
+        // Dijkstra's partition into [first, less) < pivot, [less, greater)
+        // == pivot and [greater, last) > pivot.
+        auto less = first, current = first, greater = last;
+        while (current < greater)
+        {
+            if (current->second < pivot)
+            {
+                std::iter_swap(less++, current++);
+            }
+            else if (pivot < current->second)
+            {
+                std::iter_swap(current, --greater);
+            }
+            else
+            {
+                ++current;
+            }
+        }
+
+        const auto lessCount = static_cast<size_t>(less - first);
+        const auto notGreaterCount = static_cast<size_t>(greater - first);
+        if (rank < lessCount)
+        {
+            last = less;
+        }
+        else if (rank < notGreaterCount)
+        {
+            return std::make_pair(less, greater);
+        }
+        else
+        {
+            rank -= notGreaterCount;
+            first = greater;
+        }
+    }
+}
+
+
+// Median, the indices of its central element(s) and every index whose
+// value equals a central element (for an even size with two different
+// central values, the ties of both).
+inline std::tuple<double, std::vector<size_t>, TieSet> medianWithTies(
+    const std::vector<double>& elements)
+{
+    const auto size = elements.size();
+    if (size == 0)
+    {
+        const auto [median, indices] = emptyMedianResult();
+        return std::make_tuple(median, indices, TieSet());
+    }
+
+    std::vector<std::pair<size_t, double> > enumerated;
+    enumerated.reserve(size);
+    for (size_t index = 0; index < size; ++index)
+    {
+        enumerated.emplace_back(index, elements[index]);
+    }
+
+    // After a selection step the element of a rank sits at that position,
+    // inside the equal range the step returned.
+    const auto ranks = middleRanks(size);
+    auto upper = selectEqualRange(enumerated.begin(), enumerated.end(), ranks.back());
+    std::vector<decltype(upper)> tieRanges {upper};
+    if (ranks.size() == 2 && enumerated.begin() + ranks.front() < upper.first)
+    {
+        // The lower central element is the largest of those in front of
+        // the range, and its ties come from one more partition step there.
+        tieRanges.push_back(selectEqualRange(enumerated.begin(), upper.first, ranks.front()));
+    }
+
+    std::vector<size_t> originalIndices;
+    double sum = 0.0;
+    for (const auto rank : ranks)
+    {
+        originalIndices.push_back(enumerated[rank].first);
+        sum += enumerated[rank].second;
+    }
+
+    TieSet ties;
+    for (const auto& [begin, end] : tieRanges)
+    {
+        ties.count += end - begin;
+    }
+    if (ties.count * 64 > size)
+    {
+        ties.bitmap.assign((size + 63) / 64, 0);
+        for (const auto& [begin, end] : tieRanges)
+        {
+            for (auto it = begin; it != end; ++it)
+            {
+                ties.bitmap[it->first / 64] |= uint64_t{1} << (it->first % 64);
+            }
+        }
+    }
+    else
+    {
+        for (const auto& [begin, end] : tieRanges)
+        {
+            for (auto it = begin; it != end; ++it)
+            {
+                ties.indices.push_back(it->first);
+            }
+        }
+        std::sort(ties.indices.begin(), ties.indices.end());
+    }
+
+    return std::make_tuple(sum / originalIndices.size(), originalIndices, ties);
+}
@@ -0,0 +1,80 @@
+// Minimal fork-join helpers used by the multithreaded median routines.
+
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// Number of threads the hardware offers, at least one.
+inline size_t hardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+// Number of worker threads to use for the given number of independent
+// tasks: never more than "threads" (the hardware's by default) and never
+// more than tasks.
+inline size_t workerCount(size_t tasks, size_t threads = hardwareThreads())
+{
+    return std::max<size_t>(1, std::min(threads, tasks));
+}
+
+
+// Splits [0, count) into contiguous non-empty chunks, one per worker, and
+// calls func(begin, end, worker) for every chunk. Every worker number in
+// [0, workerCount(count, threadLimit)) gets a chunk, so callers can use it
+// to pick a preallocated per-thread workspace. "func" must not throw: an
+// exception escaping a worker thread terminates the program.
+template<typename Func>
+void parallelFor(size_t count, size_t threadLimit, Func&& func)
+{
+    const auto workers = workerCount(count, threadLimit);
+    if (workers <= 1)
+    {
+        if (count > 0)
+        {
+            func(size_t{0}, count, size_t{0});
+        }
+        return;
+    }
+
+    // Chunk sizes differ by at most one, and none is empty because there
+    // are no more workers than elements.
+    std::vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; ++worker)
+    {
+        const auto begin = worker * count / workers;
+        const auto end = (worker + 1) * count / workers;
+        try
+        {
+            threads.emplace_back([&func, begin, end, worker]()
+                { func(begin, end, worker); });
+        }
+        catch (...)
+        {
+            // Joinable threads must not be destroyed: wait for those that
+            // did start before reporting that a thread could not.
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            throw;
+        }
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+
+// parallelFor with as many workers as the hardware offers.
+template<typename Func>
+void parallelFor(size_t count, Func&& func)
+{
+    parallelFor(count, hardwareThreads(), std::forward<Func>(func));
+}
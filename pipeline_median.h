@@ -0,0 +1,465 @@
+// Pipelined per-column CSV medians for streamed input.
+//
+// Three stages run at once: a reader fills fixed-size byte blocks from the
+// stream, a parser turns blocks into batches of per-column values, and an
+// accumulator collects every column's values and sorts them into runs of
+// fixed size as they fill up. At the end of the stream only the central
+// ranks are searched across the runs (see sorted_runs_median.h). Stages
+// hand buffers over through single-producer single-consumer queues that
+// are lock-free while neither side has to wait, and a second queue per
+// link returns used buffers, so a fixed set of buffers is recycled and
+// nothing is allocated per block. Reading, parsing and sorting overlap,
+// and the end-to-end time approaches that of the slowest stage instead of
+// their sum. An exception in any stage stops all of them and is rethrown
+// to the caller.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "csv_median.h"
+#include "median.h"
+#include "sorted_runs_median.h"
+
+
+constexpr size_t kPipelineBlockBytes = 1 << 20;
+constexpr size_t kPipelineBuffers = 8;
+constexpr size_t kPipelineRunSize = 1 << 16;
+
+// Attempts of a blocking push or pop before it sleeps.
+constexpr size_t kPipelineSpins = 256;
+
+
+// A bounded queue between exactly one producer thread and one consumer
+// thread. tryPush and tryPop are lock-free. push and pop retry them,
+// yielding, up to kPipelineSpins times and then sleep until the other side
+// makes progress, so a stalled stage does not keep a core busy. cancel()
+// wakes both sides for good: push then discards its value and pop returns
+// a value-initialized T.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    bool tryPush(const T& value)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        slots_[tail % Capacity] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = slots_[head % Capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T& value)
+    {
+        if (waitFor([&]() { return tryPush(value); }))
+        {
+            wake();
+        }
+    }
+
+    T pop()
+    {
+        T value {};
+        if (waitFor([&]() { return tryPop(value); }))
+        {
+            wake();
+            return value;
+        }
+        return T {};
+    }
+
+    // May be called from any thread.
+    void cancel()
+    {
+        cancelled_.store(true);
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed_.notify_all();
+    }
+
+private:
+    // Retries "attempt" until it succeeds (true) or the queue is cancelled
+    // (false), spinning first and then sleeping on the condition variable.
+    template<typename Attempt>
+    bool waitFor(Attempt&& attempt)
+    {
+        for (size_t spin = 0; spin < kPipelineSpins; ++spin)
+        {
+            if (cancelled_.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            if (attempt())
+            {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+
+        // The fences pair with the one in wake(): either the other side
+        // sees this waiter, or the attempt below sees its progress.
+        waiters_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool done = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&]() { return cancelled_.load() || (done = attempt()); });
+        }
+        waiters_.fetch_sub(1);
+        return done;
+    }
+
+    // Wakes the other side if it sleeps, after a position was published.
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            changed_.notify_all();
+        }
+    }
+
+    std::array<T, Capacity> slots_;
+    // Producer and consumer positions on separate cache lines.
+    alignas(64) std::atomic<size_t> head_ {0};
+    alignas(64) std::atomic<size_t> tail_ {0};
+    std::atomic<size_t> waiters_ {0};
+    std::atomic<bool> cancelled_ {false};
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+
+// A block of raw input; "size" bytes are valid.
+struct ByteBlock
+{
+    std::vector<char> bytes = std::vector<char>(kPipelineBlockBytes);
+    size_t size = 0;
+};
+
+
+// Parsed rows [firstRow, firstRow + rows) as one array per column.
+struct ValueBatch
+{
+    size_t firstRow = 0;
+    size_t rows = 0;
+    std::vector<std::vector<double> > columns;
+};
+
+
+// Parses complete lines into batches: the first line names the columns.
+class CsvBatchParser
+{
+public:
+    // Empties "batch" for the rows that follow.
+    void reset(ValueBatch& batch) const
+    {
+        batch.firstRow = rows_;
+        batch.rows = 0;
+        for (auto& column : batch.columns)
+        {
+            column.clear();
+        }
+    }
+
+    // Appends the lines of [begin, end) to "batch".
+    void parse(const char* begin, const char* end, ValueBatch& batch)
+    {
+        forEachLine(begin, end, [&](const char* line, const char* lineEnd)
+        {
+            if (!headerSeen_)
+            {
+                forEachField(line, lineEnd,
+                    [&](size_t, const char* first, const char* fieldEnd)
+                {
+                    names_.emplace_back(first, fieldEnd);
+                });
+                headerSeen_ = true;
+                return;
+            }
+            batch.columns.resize(names_.size());
+            for (auto& column : batch.columns)
+            {
+                column.push_back(std::numeric_limits<double>::quiet_NaN());
+            }
+            forEachField(line, lineEnd,
+                [&](size_t column, const char* first, const char* fieldEnd)
+            {
+                if (column < names_.size())
+                {
+                    batch.columns[column].back() = parseField(first, fieldEnd);
+                }
+            });
+            ++batch.rows;
+            ++rows_;
+        });
+    }
+
+    const std::vector<std::string>& names() const { return names_; }
+
+private:
+    bool headerSeen_ = false;
+    size_t rows_ = 0;
+    std::vector<std::string> names_;
+};
+
+
+// The values of one column as sorted runs, each with the rows of its
+// values, plus the pairs not sorted into a run yet.
+struct ColumnRuns
+{
+    std::vector<std::vector<double> > values;
+    std::vector<std::vector<size_t> > rows;
+    std::vector<std::pair<double, size_t> > pending;
+
+    // Sorts the pending pairs into a new run.
+    void seal()
+    {
+        std::sort(pending.begin(), pending.end());
+        values.emplace_back();
+        rows.emplace_back();
+        values.back().reserve(pending.size());
+        rows.back().reserve(pending.size());
+        for (const auto& [value, row] : pending)
+        {
+            values.back().push_back(value);
+            rows.back().push_back(row);
+        }
+        pending.clear();
+    }
+
+    // Seals what is pending and selects the central rank(s) over the runs.
+    MedianResult median()
+    {
+        if (!pending.empty())
+        {
+            seal();
+        }
+        size_t total = 0;
+        for (const auto& run : values)
+        {
+            total += run.size();
+        }
+        const auto ranks = middleRanks(total);
+        if (ranks.empty())
+        {
+            return emptyMedianResult();
+        }
+        double sum = 0.0;
+        std::vector<size_t> originalRows;
+        for (const auto rank : ranks)
+        {
+            const auto [run, offset] = selectFromRuns(values, rank);
+            sum += values[run][offset];
+            originalRows.push_back(rows[run][offset]);
+        }
+        return std::make_tuple(sum / originalRows.size(), originalRows);
+    }
+};
+
+
+// Column names and the median of every column of CSV text read from
+// "input", with the data rows of the central elements. The caller's thread
+// accumulates while two more threads read and parse.
+inline std::tuple<std::vector<std::string>, std::vector<MedianResult> >
+    pipelinedColumnMedians(std::istream& input)
+{
+    std::vector<ByteBlock> blocks(kPipelineBuffers);
+    std::vector<ValueBatch> batches(kPipelineBuffers);
+    SpscQueue<ByteBlock*, kPipelineBuffers> freeBlocks, fullBlocks;
+    SpscQueue<ValueBatch*, kPipelineBuffers> freeBatches, fullBatches;
+    for (size_t i = 0; i < kPipelineBuffers; ++i)
+    {
+        freeBlocks.push(&blocks[i]);
+        freeBatches.push(&batches[i]);
+    }
+
+    // A stage that fails records its exception and cancels every queue, so
+    // the others stop at their next push or pop; the first failure is
+    // rethrown once all of them have stopped.
+    std::exception_ptr readerError, parserError, accumulatorError;
+    const auto cancel = [&]()
+    {
+        freeBlocks.cancel();
+        fullBlocks.cancel();
+        freeBatches.cancel();
+        fullBatches.cancel();
+    };
+
+    // A null pointer marks the end of the stream, and pop returns one
+    // after a cancellation too.
+    std::thread reader([&]()
+    {
+        try
+        {
+            while (auto block = freeBlocks.pop())
+            {
+                input.read(block->bytes.data(), block->bytes.size());
+                block->size = static_cast<size_t>(input.gcount());
+                if (block->size == 0)
+                {
+                    // The block stays out of circulation: only the parser
+                    // returns blocks to the free queue.
+                    fullBlocks.push(nullptr);
+                    return;
+                }
+                fullBlocks.push(block);
+            }
+        }
+        catch (...)
+        {
+            readerError = std::current_exception();
+            cancel();
+        }
+    });
+
+    // Lines cut by a block boundary are completed in "carry". The names
+    // are read by the accumulator after the end of the stream.
+    CsvBatchParser parser;
+    const auto parse = [&]()
+    {
+        try
+        {
+            std::string carry;
+            while (auto block = fullBlocks.pop())
+            {
+                const char* begin = block->bytes.data();
+                const auto end = begin + block->size;
+                const auto firstNewline =
+                    static_cast<const char*>(std::memchr(begin, '\n', block->size));
+                auto batch = freeBatches.pop();
+                if (batch == nullptr)
+                {
+                    return;
+                }
+                parser.reset(*batch);
+                if (firstNewline == nullptr)
+                {
+                    carry.append(begin, end);
+                }
+                else
+                {
+                    auto lastNewline = end;
+                    while (lastNewline[-1] != '\n')
+                    {
+                        --lastNewline;
+                    }
+                    // Only the line cut by the previous boundary is copied.
+                    carry.append(begin, firstNewline + 1);
+                    parser.parse(carry.data(), carry.data() + carry.size(), *batch);
+                    parser.parse(firstNewline + 1, lastNewline, *batch);
+                    carry.assign(lastNewline, end);
+                }
+                freeBlocks.push(block);
+                fullBatches.push(batch);
+            }
+            auto batch = freeBatches.pop();
+            if (batch == nullptr)
+            {
+                return;
+            }
+            parser.reset(*batch);
+            parser.parse(carry.data(), carry.data() + carry.size(), *batch);
+            fullBatches.push(batch);
+            fullBatches.push(nullptr);
+        }
+        catch (...)
+        {
+            parserError = std::current_exception();
+            cancel();
+        }
+    };
+    std::thread parserThread;
+    try
+    {
+        parserThread = std::thread(parse);
+    }
+    catch (...)
+    {
+        cancel();
+        reader.join();
+        throw;
+    }
+
+    // Every column accumulates (value, row) pairs until there are enough
+    // to sort into a run; the median is then searched across the runs.
+    std::vector<ColumnRuns> columns;
+    try
+    {
+        while (auto batch = fullBatches.pop())
+        {
+            if (columns.size() < batch->columns.size())
+            {
+                columns.resize(batch->columns.size());
+            }
+            for (size_t column = 0; column < batch->columns.size(); ++column)
+            {
+                auto& runs = columns[column];
+                for (size_t row = 0; row < batch->rows; ++row)
+                {
+                    const auto value = batch->columns[column][row];
+                    if (!std::isnan(value))
+                    {
+                        runs.pending.emplace_back(value, batch->firstRow + row);
+                    }
+                }
+                if (runs.pending.size() >= kPipelineRunSize)
+                {
+                    runs.seal();
+                }
+            }
+            freeBatches.push(batch);
+        }
+    }
+    catch (...)
+    {
+        accumulatorError = std::current_exception();
+        cancel();
+    }
+    reader.join();
+    parserThread.join();
+    for (const auto& error : {readerError, parserError, accumulatorError})
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    const auto& names = parser.names();
+    std::vector<MedianResult> medians(names.size(), emptyMedianResult());
+    for (size_t column = 0; column < columns.size(); ++column)
+    {
+        medians[column] = columns[column].median();
+    }
+    return std::make_tuple(names, medians);
+}
@@ -0,0 +1,74 @@
+// Checks rangeMedian (fused_median.h), which only exists in C++20 builds:
+// for several view pipelines the value must match a sorted copy of the
+// view, and every reported index must point at an underlying element that
+// the view yields and whose transformed value is a central one.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include "fused_median.h"
+
+
+int failures = 0;
+
+
+template<typename View, typename Transform>
+void check(const std::string& name, const std::vector<double>& data, View view,
+    Transform transform)
+{
+    std::vector<double> values(view.begin(), view.end());
+    std::sort(values.begin(), values.end());
+    const auto size = values.size();
+    const auto expected = size % 2 == 1 ? values[size / 2] :
+        (values[size / 2 - 1] + values[size / 2]) / 2;
+
+    const auto [median_value, indices] = rangeMedian(view);
+    auto ok = median_value == expected && indices.size() == (size % 2 == 1 ? 1 : 2);
+    for (const auto index : indices)
+    {
+        ok = ok && index < data.size() &&
+            std::find(view.begin(), view.end(), transform(data[index])) != view.end() &&
+            (transform(data[index]) == values[(size - 1) / 2] ||
+                transform(data[index]) == values[size / 2]);
+    }
+    if (!ok)
+    {
+        std::cerr << name << " failed: median_value=" << median_value << " expected="
+            << expected << std::endl;
+        ++failures;
+    }
+}
+
+
+int main()
+{
+    const std::vector<double> data {5, 1, 4, 2, 3, 6, 9, -7, 8};
+    const auto same = [](double value) { return value; };
+    const auto twice = [](double value) { return 2 * value; };
+    const auto positive = [](double value) { return value > 0; };
+
+    check("all", data, std::views::all(data), same);
+    check("filter|transform", data,
+        data | std::views::filter(positive) | std::views::transform(twice), twice);
+    check("reverse|take", data, data | std::views::reverse | std::views::take(4), same);
+    check("drop|reverse", data, data | std::views::drop(2) | std::views::reverse, same);
+    check("filter|reverse|transform", data, data | std::views::filter(positive) |
+        std::views::reverse | std::views::transform(twice), twice);
+
+    // Reversed views of 6 elements: the last element is index 5, not 6.
+    const std::vector<double> six {5, 1, 4, 2, 3, 6};
+    const auto [median_value, indices] = rangeMedian(six | std::views::reverse |
+        std::views::take(3));
+    if (median_value != 3 || indices.front() != 4)
+    {
+        std::cerr << "reverse|take index " << indices.front() << std::endl;
+        ++failures;
+    }
+
+    std::cout << (failures == 0 ? "ranges checks passed" : "ranges checks failed") << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
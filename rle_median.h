@@ -0,0 +1,100 @@
+// Median directly over run-length-encoded data.
+//
+// A run (value, length) stands for "length" consecutive rows holding the
+// same value. A rank is found by weighted quickselect over the runs: a
+// pivot run splits the others into smaller and larger ones, and the total
+// length on each side tells which side holds the rank. The row position
+// follows from the run's starting row, so nothing is ever expanded.
+
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// A run-length-encoded column as (value, run length) pairs in row order.
+using RunLengthColumn = std::vector<std::pair<double, size_t> >;
+
+
+// Row position and value of the element of the given rank. Equal values
+// are ordered by row, so every rank maps to a distinct row.
+inline std::pair<size_t, double> selectRunLengthRank(
+    const RunLengthColumn& column, size_t rank)
+{
+    // (value, first row, length) of every non-empty run.
+    std::vector<std::tuple<double, size_t, size_t> > runs;
+    size_t row = 0;
+    for (const auto& [value, length] : column)
+    {
+        if (length > 0)
+        {
+            runs.emplace_back(value, row, length);
+        }
+        row += length;
+    }
+
+    auto first = runs.begin();
+    auto last = runs.end();
+    while (true)
+    {
+        const auto pivot = *(first + (last - first) / 2);
+        const auto middle = std::partition(first, last, [&](const auto& run)
+            { return std::tie(std::get<0>(run), std::get<1>(run)) <
+                std::tie(std::get<0>(pivot), std::get<1>(pivot)); });
+
+        size_t smaller = 0;
+        for (auto run = first; run != middle; ++run)
+        {
+            smaller += std::get<2>(*run);
+        }
+
+        if (rank < smaller)
+        {
+            last = middle;
+        }
+        else if (rank < smaller + std::get<2>(pivot))
+        {
+            return std::make_pair(std::get<1>(pivot) + (rank - smaller),
+                std::get<0>(pivot));
+        }
+        else
+        {
+            // Everything from "middle" on is not smaller than the pivot,
+            // and the pivot itself is excluded by moving it to the front.
+            const auto self = std::find(middle, last, pivot);
+            std::iter_swap(middle, self);
+            rank -= smaller + std::get<2>(pivot);
+            first = middle + 1;
+        }
+    }
+}
+
+
+// Median of a run-length-encoded column with the row position(s) of the
+// element(s) it was computed from.
+inline MedianResult runLengthMedian(const RunLengthColumn& column)
+{
+    size_t total = 0;
+    for (const auto& run : column)
+    {
+        total += run.second;
+    }
+    if (total == 0)
+    {
+        return emptyMedianResult();
+    }
+
+    std::vector<size_t> rows;
+    double sum = 0.0;
+    for (const auto rank : middleRanks(total))
+    {
+        const auto [row, value] = selectRunLengthRank(column, rank);
+        rows.push_back(row);
+        sum += value;
+    }
+    return std::make_tuple(sum / rows.size(), rows);
+}
@@ -0,0 +1,184 @@
+// Median of K sorted runs without merging them.
+//
+// The element of a given rank is found by narrowing a range [lo, hi) in
+// every run at once. The pivot is the weighted median of the middles of
+// the active ranges, so at least a quarter of the active elements is
+// discarded per round, and each round costs one binary search per run:
+// O(K log n) per round, O(log n) rounds. Two runs get the classic
+// partition search, which needs a single O(log n) binary search.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// The position of an element as (run, offset within the run).
+using RunLocation = std::pair<size_t, size_t>;
+
+// A median over sorted runs: the value and the location(s) it came from.
+using RunsMedian = std::tuple<double, std::vector<RunLocation> >;
+
+
+// Location of the element of the given rank in the union of two sorted
+// runs. Searches for how many of the rank + 1 smallest come from "a".
+inline RunLocation selectFromTwoRuns(
+    const std::vector<double>& a, const std::vector<double>& b, size_t rank)
+{
+    const auto needed = rank + 1;
+    size_t lo = needed > b.size() ? needed - b.size() : 0;
+    size_t hi = std::min(needed, a.size());
+    while (lo < hi)
+    {
+        const auto fromA = lo + (hi - lo) / 2;
+        if (b[needed - fromA - 1] > a[fromA])
+        {
+            lo = fromA + 1;
+        }
+        else
+        {
+            hi = fromA;
+        }
+    }
+    const auto fromB = needed - lo;
+    if (fromB == 0 || (lo > 0 && a[lo - 1] >= b[fromB - 1]))
+    {
+        return RunLocation(0, lo - 1);
+    }
+    return RunLocation(1, fromB - 1);
+}
+
+
+// Access to the values of a run held directly or through a shared pointer.
+inline const std::vector<double>& runValues(const std::vector<double>& run)
+{
+    return run;
+}
+
+inline const std::vector<double>& runValues(
+    const std::shared_ptr<const std::vector<double> >& run)
+{
+    return *run;
+}
+
+
+// Location of the element of the given rank in the union of K sorted runs.
+// "runs" is a vector of runs or of shared pointers to runs.
+template<typename Runs>
+RunLocation selectFromRuns(const Runs& runs, size_t rank)
+{
+    if (runs.size() == 2)
+    {
+        return selectFromTwoRuns(runValues(runs[0]), runValues(runs[1]), rank);
+    }
+
+    const auto k = runs.size();
+    std::vector<size_t> lo(k, 0), hi(k);
+    for (size_t r = 0; r < k; ++r)
+    {
+        hi[r] = runValues(runs[r]).size();
+    }
+
+    std::vector<std::pair<double, size_t> > middles;
+    std::vector<size_t> below(k), upTo(k);
+    while (true)
+    {
+        // The weighted median of the middles of the active ranges.
+        middles.clear();
+        size_t active = 0;
+        for (size_t r = 0; r < k; ++r)
+        {
+            if (lo[r] < hi[r])
+            {
+                const auto& run = runValues(runs[r]);
+                middles.emplace_back(run[lo[r] + (hi[r] - lo[r]) / 2], hi[r] - lo[r]);
+                active += hi[r] - lo[r];
+            }
+        }
+        std::sort(middles.begin(), middles.end());
+        double pivot = middles.back().first;
+        size_t weight = 0;
+        for (const auto& [middle, size] : middles)
+        {
+            weight += size;
+            if (2 * weight >= active)
+            {
+                pivot = middle;
+                break;
+            }
+        }
+
+        size_t less = 0, lessOrEqual = 0;
+        for (size_t r = 0; r < k; ++r)
+        {
+            const auto& run = runValues(runs[r]);
+            const auto first = run.begin() + lo[r];
+            const auto last = run.begin() + hi[r];
+            below[r] = std::lower_bound(first, last, pivot) - run.begin();
+            upTo[r] = std::upper_bound(first, last, pivot) - run.begin();
+            less += below[r] - lo[r];
+            lessOrEqual += upTo[r] - lo[r];
+        }
+
+        if (rank < less)
+        {
+            hi = below;
+        }
+        else if (rank >= lessOrEqual)
+        {
+            lo = upTo;
+            rank -= lessOrEqual;
+        }
+        else
+        {
+            // The element equals the pivot; walk the runs' equal ranges.
+            rank -= less;
+            for (size_t r = 0; r < k; ++r)
+            {
+                const auto equal = upTo[r] - below[r];
+                if (rank < equal)
+                {
+                    return RunLocation(r, below[r] + rank);
+                }
+                rank -= equal;
+            }
+        }
+    }
+}
+
+
+// Median of the union of sorted runs with the location(s) of the element(s)
+// it was computed from.
+inline RunsMedian sortedRunsMedian(const std::vector<std::vector<double> >& runs)
+{
+    size_t total = 0;
+    for (const auto& run : runs)
+    {
+        total += run.size();
+    }
+
+    auto result = std::make_tuple(
+        std::numeric_limits<double>::quiet_NaN(), std::vector<RunLocation>());
+    const auto ranks = middleRanks(total);
+    if (ranks.empty())
+    {
+        return result;
+    }
+
+    double sum = 0.0;
+    std::vector<RunLocation> locations;
+    for (const auto rank : ranks)
+    {
+        const auto location = selectFromRuns(runs, rank);
+        sum += runs[location.first][location.second];
+        locations.push_back(location);
+    }
+    return std::make_tuple(sum / locations.size(), locations);
+}
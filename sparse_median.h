@@ -0,0 +1,113 @@
+// Median of sparse data with implicit zeros.
+//
+// A sparse vector of logical size n stores only its non-zero entries as
+// (index, value) pairs. In sorted order it is the negatives, then a band
+// of zeros, then the positives, and the band size is known without looking
+// at the zeros: n minus the number of explicit non-zeros. So a middle rank
+// either selects among the explicit negatives or positives, or falls into
+// the band, whose value is 0 and whose positions are found from the gaps
+// between explicit indices. All of it is O(nnz).
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Index of the zero-th, first, ... zero of a sparse vector, counting zeros
+// in index order. Explicit entries must be sorted by index; explicitly
+// stored zeros count as zeros.
+inline size_t nthZeroIndex(const std::vector<size_t>& indices,
+    const std::vector<double>& values, size_t nth)
+{
+    size_t next = 0;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        // Implicit zeros in the gap in front of this entry.
+        const auto gap = indices[i] - next;
+        if (nth < gap)
+        {
+            return next + nth;
+        }
+        nth -= gap;
+        if (values[i] == 0.0)
+        {
+            if (nth == 0)
+            {
+                return indices[i];
+            }
+            --nth;
+        }
+        next = indices[i] + 1;
+    }
+    return next + nth;
+}
+
+
+// Median of a sparse vector of logical size "size" given by its explicit
+// entries, sorted by index. Returned indices are positions in the dense
+// vector; tied zeros are reported in index order.
+inline MedianResult sparseMedian(size_t size, const std::vector<size_t>& indices,
+    const std::vector<double>& values)
+{
+    if (size == 0)
+    {
+        return emptyMedianResult();
+    }
+
+    std::vector<std::pair<size_t, double> > negatives, positives;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (values[i] < 0.0)
+        {
+            negatives.emplace_back(indices[i], values[i]);
+        }
+        else if (values[i] > 0.0)
+        {
+            positives.emplace_back(indices[i], values[i]);
+        }
+    }
+    const auto zeros = size - negatives.size() - positives.size();
+
+    // Ranks are selected from the top down, and every selection shrinks its
+    // partition to the elements in front of the selected one, so that a
+    // second rank in the same partition cannot pick the same element.
+    auto negativesEnd = negatives.size();
+    auto positivesEnd = positives.size();
+    const auto byValue = [](const auto& a, const auto& b)
+        { return a.second < b.second; };
+    const auto selectRank = [&](size_t rank)
+    {
+        if (rank < negatives.size())
+        {
+            std::nth_element(negatives.begin(), negatives.begin() + rank,
+                negatives.begin() + negativesEnd, byValue);
+            negativesEnd = rank;
+            return negatives[rank];
+        }
+        rank -= negatives.size();
+        if (rank < zeros)
+        {
+            return std::make_pair(nthZeroIndex(indices, values, rank), 0.0);
+        }
+        rank -= zeros;
+        std::nth_element(positives.begin(), positives.begin() + rank,
+            positives.begin() + positivesEnd, byValue);
+        positivesEnd = rank;
+        return positives[rank];
+    };
+
+    const auto ranks = middleRanks(size);
+    std::vector<size_t> originalIndices(ranks.size());
+    double sum = 0.0;
+    for (size_t i = ranks.size(); i-- > 0; )
+    {
+        const auto [index, value] = selectRank(ranks[i]);
+        originalIndices[i] = index;
+        sum += value;
+    }
+    return std::make_tuple(sum / originalIndices.size(), originalIndices);
+}
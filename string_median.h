@@ -0,0 +1,224 @@
+// Median of keys that are not numbers: strings, or any type with a
+// comparator.
+//
+// There is no mean of two strings, so the result holds the central key(s)
+// themselves (one for an odd size, two for an even size) with their
+// indices. For strings, selection runs over (prefix, index) pairs where
+// the prefix is 8 bytes of the string read as a big-endian integer.
+// Integer order of prefixes agrees with lexicographic order of the
+// strings, so comparisons are integer compares on contiguous memory. Ties
+// are not resolved by comparing whole strings: only the strings tied with
+// the selected prefix load their next 8 bytes and are selected again
+// (multikey quickselect). Bytes shared by all keys, such as a URL scheme,
+// are skipped up front.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// The central key(s) in order and their indices.
+template<typename Key>
+using KeyMedian = std::tuple<std::vector<Key>, std::vector<size_t> >;
+
+
+// Selects the central ranks of "entries" ordered by "less" and returns
+// the entries at the lower and upper ranks (only one for an odd size).
+template<typename Entry, typename Less>
+std::vector<Entry> selectCentral(std::vector<Entry>& entries, Less less)
+{
+    if (entries.empty())
+    {
+        return {};
+    }
+    const auto ranks = middleRanks(entries.size());
+    const auto upper = entries.begin() + ranks.back();
+    std::nth_element(entries.begin(), upper, entries.end(), less);
+    std::vector<Entry> central {*upper};
+    if (ranks.size() == 2)
+    {
+        central.insert(central.begin(), *std::max_element(entries.begin(), upper, less));
+    }
+    return central;
+}
+
+
+// Median of arbitrary keys under a strict weak ordering "compare".
+template<typename Key, typename Compare = std::less<Key> >
+KeyMedian<Key> medianKey(const std::vector<Key>& keys, Compare compare = Compare())
+{
+    std::vector<size_t> order(keys.size());
+    for (size_t index = 0; index < keys.size(); ++index)
+    {
+        order[index] = index;
+    }
+    const auto central = selectCentral(order,
+        [&](size_t a, size_t b) { return compare(keys[a], keys[b]); });
+
+    std::vector<Key> values;
+    for (const auto index : central)
+    {
+        values.push_back(keys[index]);
+    }
+    return std::make_tuple(values, central);
+}
+
+
+// Length of the longest prefix common to all keys.
+inline size_t commonPrefixLength(const std::vector<std::string>& keys)
+{
+    if (keys.empty())
+    {
+        return 0;
+    }
+    auto length = keys.front().size();
+    for (const auto& key : keys)
+    {
+        length = std::min(length, key.size());
+        length = std::mismatch(key.begin(), key.begin() + length, keys.front().begin()).first
+            - key.begin();
+    }
+    return length;
+}
+
+
+// A string during selection: 8 bytes of it from the current offset as a
+// big-endian integer (zero-padded), how many bytes it has left there
+// capped at 9 ("continues past the window"), and its index, packed to 16
+// bytes with the tail in the low 4 bits of the last word. Ordering by
+// (prefix, tail) agrees with the order of the strings when they are equal
+// before the offset: of two strings whose windows agree after padding,
+// the one that ends first is a prefix of the other.
+struct PrefixEntry
+{
+    uint64_t prefix;
+    uint64_t indexAndTail;
+
+    size_t index() const { return indexAndTail >> 4; }
+    unsigned tail() const { return indexAndTail & 15; }
+
+    bool operator<(const PrefixEntry& other) const
+    {
+        return prefix != other.prefix ? prefix < other.prefix : tail() < other.tail();
+    }
+
+    bool operator==(const PrefixEntry& other) const
+    {
+        return prefix == other.prefix && tail() == other.tail();
+    }
+};
+
+
+// Loads the window of "key" at "offset" into "entry".
+inline void loadPrefix(PrefixEntry& entry, const std::string& key, size_t offset)
+{
+    const auto remaining = key.size() > offset ? key.size() - offset : 0;
+    uint64_t prefix = 0;
+    std::memcpy(&prefix, key.data() + std::min(offset, key.size()),
+        std::min(remaining, sizeof(prefix)));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    prefix = __builtin_bswap64(prefix);
+#endif
+    entry.prefix = prefix;
+    entry.indexAndTail = entry.index() << 4 | std::min<size_t>(remaining, 9);
+}
+
+
+// Multikey quickselect: selects the given rank of [first, last) on the
+// cached prefixes, and only where the selected prefix is tied reloads the
+// next 8 bytes of the tied strings and selects again among them. The
+// strings in the range must be equal before "offset". Returns the
+// positions of the elements of ranks rank - 1 (if "lowerToo") and rank;
+// everything in front of either is not greater.
+template<typename Iterator>
+std::pair<Iterator, Iterator> selectStringRanks(Iterator first, Iterator last, size_t rank,
+    bool lowerToo, const std::vector<std::string>& keys, size_t offset)
+{
+    auto lower = last;
+    auto lowerFound = !lowerToo;
+    while (true)
+    {
+        for (auto it = first; it != last; ++it)
+        {
+            loadPrefix(*it, keys[it->index()], offset);
+        }
+        const auto nth = first + rank;
+        std::nth_element(first, nth, last);
+        const auto pivot = *nth;
+
+        // Gather the ties of the pivot around it.
+        const auto tiedBegin = std::partition(first, nth,
+            [&pivot](const PrefixEntry& entry) { return entry < pivot; });
+        const auto tiedEnd = std::partition(nth, last,
+            [&pivot](const PrefixEntry& entry) { return entry == pivot; });
+
+        if (!lowerFound && nth == tiedBegin)
+        {
+            // The lower rank falls in front of the ties: it is the largest
+            // there, found among the ties of the largest prefix.
+            const auto largest = *std::max_element(first, tiedBegin);
+            const auto group = std::partition(first, tiedBegin,
+                [&largest](const PrefixEntry& entry) { return entry < largest; });
+            lower = largest.tail() <= sizeof(uint64_t) || tiedBegin - group == 1 ? group :
+                selectStringRanks(group, tiedBegin, static_cast<size_t>(tiedBegin - group) - 1,
+                    false, keys, offset + sizeof(uint64_t)).second;
+            lowerFound = true;
+        }
+        if (pivot.tail() <= sizeof(uint64_t) || tiedEnd - tiedBegin == 1)
+        {
+            // The tied strings are all equal, or there is only one.
+            if (!lowerFound)
+            {
+                lower = nth - 1;
+            }
+            return std::make_pair(lower, nth);
+        }
+        rank = static_cast<size_t>(nth - tiedBegin);
+        first = tiedBegin;
+        last = tiedEnd;
+        offset += sizeof(uint64_t);
+    }
+}
+
+
+// Lexicographic (byte-wise) median of strings with prefix caching.
+inline KeyMedian<std::string> stringMedian(const std::vector<std::string>& keys)
+{
+    const auto size = keys.size();
+    if (size == 0)
+    {
+        return std::make_tuple(std::vector<std::string>(), std::vector<size_t>());
+    }
+
+    const auto offset = commonPrefixLength(keys);
+    std::vector<PrefixEntry> entries(size);
+    for (size_t index = 0; index < size; ++index)
+    {
+        entries[index].indexAndTail = uint64_t{index} << 4;
+    }
+
+    const auto ranks = middleRanks(size);
+    const auto [lower, upper] = selectStringRanks(entries.begin(), entries.end(),
+        ranks.back(), ranks.size() == 2, keys, offset);
+    std::vector<size_t> indices {upper->index()};
+    if (ranks.size() == 2)
+    {
+        indices.insert(indices.begin(), lower->index());
+    }
+
+    std::vector<std::string> values;
+    for (const auto index : indices)
+    {
+        values.push_back(keys[index]);
+    }
+    return std::make_tuple(values, indices);
+}
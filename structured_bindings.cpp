@@ -14,6 +14,33 @@
 #include <algorithm>
 #include <limits>
 #include <numeric>
+#include <random>
+#include <fstream>
+#include <string>
+
+#include "append_store.h"
+#include "approximate_median.h"
+#include "bootstrap.h"
+#include "compressed_median.h"
+#include "csv_median.h"
+#include "bucketed_median.h"
+#include "dictionary_median.h"
+#include "fused_median.h"
+#include "gather_median.h"
+#include "hampel.h"
+#include "lazy_median.h"
+#include "median_cache.h"
+#include "masked_median.h"
+#include "rle_median.h"
+#include "median_polish.h"
+#include "median_ties.h"
+#include "pipeline_median.h"
+#include "sorted_runs_median.h"
+#include "sparse_median.h"
+#include "string_median.h"
+#include "theil_sen.h"
+#include "time_window_median.h"
+#include "tracked_array.h"
 
 
 // Here we declare a helper function to print out a vector to the console.
@@ -29,6 +56,465 @@ void printVector(const std::vector<T>& vector)
 };
 
 
+// Robust line fits return slope, intercept and the defining point pairs,
+// all unpacked at once into const bindings just like the median below.
+void theilSenExample()
+{
+    const std::vector<double> x {0, 1, 2, 3, 4, 5, 6, 7};
+    const std::vector<double> y {0.1, 1.0, 2.1, 2.9, 40.0, 5.1, 5.9, 7.0};
+
+    const auto [slope, intercept, pairs] = theilSen(x, y);
+    std::cout << "theil_sen slope=" << slope << " intercept=" << intercept;
+    std::cout << " pairs=[ ";
+    for (const auto& [i, j] : pairs)
+    {
+        std::cout << "(" << i << "," << j << ") ";
+    }
+    std::cout << "]" << std::endl;
+
+    const auto [rmSlope, rmIntercept, rmPairs] = repeatedMedian(x, y);
+    std::cout << "repeated_median slope=" << rmSlope
+        << " intercept=" << rmIntercept << " pairs=[ ";
+    for (const auto& [i, j] : rmPairs)
+    {
+        std::cout << "(" << i << "," << j << ") ";
+    }
+    std::cout << "]" << std::endl;
+    // Integer data has huge blocks of equal slopes: here the median slope
+    // 0 is shared by about 2% of the 1.1M slopes, and the rank selection
+    // has to resolve ties at either end of its interval.
+    std::mt19937_64 generator(2);
+    std::vector<double> xTied(1500), yTied(1500);
+    for (size_t i = 0; i < xTied.size(); ++i)
+    {
+        xTied[i] = static_cast<double>(generator() % 400);
+        yTied[i] = static_cast<double>(generator() % 50);
+    }
+    const auto [tiedSlope, tiedIntercept, tiedPairs] = theilSen(xTied, yTied);
+    std::cout << "theil_sen (ties) slope=" << tiedSlope
+        << " intercept=" << tiedIntercept << std::endl;
+}
+
+
+// Median polish splits a table into overall, row and column effects and
+// leaves the residuals in the table itself.
+void medianPolishExample()
+{
+    std::vector<double> table {
+        14, 15, 14,
+         7,  4,  7,
+         8,  2, 10,
+        15,  9, 10,
+         0,  2,  0
+        };
+
+    const auto [overall, rowEffects, columnEffects, sweeps] =
+        medianPolish(table.data(), 5, 3);
+    std::cout << "median_polish overall=" << overall << " rows=";
+    printVector(rowEffects);
+    std::cout << " columns=";
+    printVector(columnEffects);
+    std::cout << " sweeps=" << sweeps << std::endl;
+}
+
+
+// A bootstrap confidence interval comes back as two more bindings next to
+// the median value and indices.
+void bootstrapExample()
+{
+    const std::vector<double> elements {
+        2.3, 0.4, 1.7, 5.5, 0.9, 1.1, 3.2, 0.2, 1.4, 2.8
+        };
+
+    const auto [median_value, indices, lower, upper] =
+        bootstrapMedian(elements, 1000, 0.9);
+    std::cout << "bootstrap median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << " ci90=[" << lower << ", " << upper << "]" << std::endl;
+}
+
+
+// The Hampel filter flags points far from their rolling median and can
+// replace them with it.
+void hampelExample()
+{
+    std::vector<double> series {
+        1.0, 1.1, 0.9, 1.0, 9.0, 1.2, 1.1, 0.8, 1.0, -7.0, 1.1
+        };
+
+    const auto [outliers, medians] = hampelFilter(series, 2, 3.0, true);
+    std::cout << "hampel outliers=";
+    printVector(outliers);
+    std::cout << " filtered=";
+    printVector(series);
+    std::cout << std::endl;
+}
+
+
+// Downsampling yields one (bucket, median, indices) triple per non-empty
+// time bucket, each of which unpacks into const bindings.
+void bucketedMedianExample()
+{
+    const std::vector<int64_t> timestamps {0, 3, 4, 9, 31, 32, 33, 45, 58};
+    const std::vector<double> values {5.0, 1.0, 3.0, 4.0, 2.0, 8.0, 7.0, 6.0, 0.5};
+
+    for (const auto& [bucket, median, indices] : bucketedMedians(timestamps, values, 15))
+    {
+        std::cout << "bucket=" << bucket << " median=" << median << " indices=";
+        printVector(indices);
+        std::cout << std::endl;
+    }
+}
+
+
+// A time-window median is queried after every event and, just like the
+// lambda's result, unpacked into const bindings.
+void timeWindowMedianExample()
+{
+    const std::vector<std::pair<int64_t, double> > events {
+        {0, 4.0}, {10, 2.0}, {25, 9.0}, {20, 1.0}, {70, 5.0}, {5, 3.0}, {90, 6.0}
+        };
+
+    TimeWindowMedian window(60, 10);
+    for (const auto& [timestamp, value] : events)
+    {
+        const auto accepted = window.push(timestamp, value);
+        const auto [median_value, indices] = window.median();
+        std::cout << "t=" << timestamp << (accepted ? "" : " (late)")
+            << " median_value=" << median_value << " indices=";
+        printVector(indices);
+        std::cout << std::endl;
+    }
+}
+
+
+// Nulls are skipped by the kernel itself, and the indices still point
+// into the unfiltered column.
+void maskedMedianExample()
+{
+    const std::vector<double> column {7.0, 0.0, 3.0, 0.0, 5.0, 1.0, 0.0, 9.0};
+    const std::vector<uint8_t> validity {0b10110101};
+
+    const auto [median_value, indices] = maskedMedian(column, validity);
+    std::cout << "masked median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << std::endl;
+}
+
+
+// The approximate median trades exactness for a sample of fixed size and
+// reports the rank interval its answer is guaranteed to fall into.
+void approximateMedianExample()
+{
+    std::vector<double> elements(1000000);
+    std::iota(elements.begin(), elements.end(), 0.0);
+    std::reverse(elements.begin(), elements.end());
+
+    const auto [median_value, indices, lowRank, highRank] =
+        approximateMedian(elements, 0.01, 0.001);
+    std::cout << "approximate median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << " ranks=[" << lowRank << ", " << highRank << "]" << std::endl;
+}
+
+
+// Gather queries return one (median_value, indices) result per subset,
+// with indices into the shared base array.
+void gatherMedianExample()
+{
+    const std::vector<double> base {0.5, 4.0, 2.5, 8.0, 1.0, 7.5};
+    const std::vector<size_t> offsets {0, 3, 5, 6};
+    const std::vector<size_t> members {1, 3, 5, 0, 2, 4};
+
+    for (const auto& [median_value, indices] : gatherMedians(base, offsets, members))
+    {
+        std::cout << "gather median_value=" << median_value << " indices=";
+        printVector(indices);
+        std::cout << std::endl;
+    }
+}
+
+
+// Sorted shards are searched in place; the median comes back with the
+// (run, offset) location(s) of its elements.
+void sortedRunsMedianExample()
+{
+    const std::vector<std::vector<double> > runs {
+        {0.1, 0.4, 2.0, 7.0},
+        {0.3, 1.5},
+        {0.2, 1.0, 3.0, 4.5, 9.0}
+        };
+
+    const auto [median_value, locations] = sortedRunsMedian(runs);
+    std::cout << "sorted_runs median_value=" << median_value << " locations=[ ";
+    for (const auto& [run, offset] : locations)
+    {
+        std::cout << "(" << run << "," << offset << ") ";
+    }
+    std::cout << "]" << std::endl;
+}
+
+
+// A sparse vector's median never looks at its implicit zeros, yet its
+// indices point into the dense vector.
+void sparseMedianExample()
+{
+    const std::vector<size_t> positions {2, 5, 6, 9};
+    const std::vector<double> values {-1.5, 2.0, 0.5, 4.0};
+
+    const auto [median_value, indices] = sparseMedian(12, positions, values);
+    std::cout << "sparse median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << std::endl;
+}
+
+
+// Run-length-encoded columns are searched run by run; the indices are the
+// rows the median would occupy in the expanded column.
+void runLengthMedianExample()
+{
+    const RunLengthColumn column {{3.0, 1000}, {1.0, 400}, {7.0, 250}, {2.0, 700}};
+
+    const auto [median_value, rows] = runLengthMedian(column);
+    std::cout << "rle median_value=" << median_value << " rows=";
+    printVector(rows);
+    std::cout << std::endl;
+}
+
+
+// A dictionary-encoded column is histogrammed straight from its packed
+// codes; only the median rows are located in a second scan.
+void dictionaryMedianExample()
+{
+    const std::vector<double> dictionary {250.0, 10.0, 75.5, 40.0};
+    const std::vector<uint32_t> codes {2, 0, 1, 3, 3, 1, 2, 0, 3};
+    const auto words = packCodes(codes, 2);
+
+    const auto [median_value, rows] =
+        dictionaryMedian(dictionary, PackedCodes{words.data(), codes.size(), 2});
+    std::cout << "dictionary median_value=" << median_value << " rows=";
+    printVector(rows);
+    std::cout << std::endl;
+}
+
+
+// Delta-compressed timestamps are narrowed block by block and decoded
+// only where they may hold the median.
+void compressedMedianExample()
+{
+    std::vector<int64_t> timestamps(1000);
+    for (size_t i = 0; i < timestamps.size(); ++i)
+    {
+        timestamps[i] = 1600000000 + static_cast<int64_t>(i * i % 7919);
+    }
+    const auto blocks = compressColumn(timestamps, true);
+
+    const auto [median_value, rows] = compressedMedian(blocks);
+    std::cout << "compressed median_value=" << static_cast<int64_t>(median_value)
+        << " rows=";
+    printVector(rows);
+    std::cout << std::endl;
+}
+
+
+// A repeated request is answered from the cache after hashing the input.
+void medianCacheExample()
+{
+    MedianCache cache(1 << 20);
+    const std::vector<double> elements {3.0, 1.0, 4.0, 1.0, 5.0, 9.0, 2.0};
+
+    for (int request = 0; request < 3; ++request)
+    {
+        const auto [median_value, indices] = cache.getOrCompute(elements, 0,
+            [](const std::vector<double>& input) { return median(input); });
+        std::cout << "cached median_value=" << median_value << " indices=";
+        printVector(indices);
+        std::cout << std::endl;
+    }
+
+    const auto [entries, hits, misses] = cache.statistics();
+    std::cout << "cache entries=" << entries << " hits=" << hits
+        << " misses=" << misses << std::endl;
+}
+
+
+// A tracked array answers the next median by repartitioning only the
+// elements that changed since the previous query.
+void trackedArrayExample()
+{
+    std::vector<double> initial(1001);
+    std::iota(initial.begin(), initial.end(), 0.0);
+    TrackedArray array(initial);
+
+    for (int round = 0; round < 3; ++round)
+    {
+        const auto [median_value, indices] = array.median();
+        std::cout << "tracked median_value=" << median_value << " indices=";
+        printVector(indices);
+        std::cout << std::endl;
+
+        // A few percent of the entries are updated between queries.
+        for (size_t index = 0; index < 30; ++index)
+        {
+            array.set(index * 7, 2000.0 + index);
+        }
+    }
+}
+
+
+// A growing dataset is queried after every appended batch without being
+// re-sorted as a whole.
+void appendStoreExample()
+{
+    AppendStore store(2);
+    const std::vector<std::vector<double> > batches {
+        {5.0, 3.0, 8.0}, {1.0, 9.0}, {4.0, 7.0, 2.0, 6.0}, {0.0}
+        };
+
+    for (const auto& batch : batches)
+    {
+        store.append(batch);
+        const auto [median_value, indices] = store.median();
+        const auto [p90, p90Indices] = store.quantile(0.9);
+        std::cout << "append_store median_value=" << median_value << " indices=";
+        printVector(indices);
+        std::cout << " p90=" << p90 << std::endl;
+    }
+}
+
+
+// With lazy indices the value-only path never pairs values with indices;
+// the scan for the indices happens only because we print them here.
+void lazyMedianExample()
+{
+    const std::vector<double> elements {
+        1.2, 1.1, -0.1, -0.2, 0, 1
+        };
+
+    const auto [median_value, indices] = lazyMedian(elements);
+    std::cout << "lazy median_value=" << median_value << " indices=";
+    printVector(indices.get());
+    std::cout << std::endl;
+}
+
+
+// For auditing, every position holding the median value comes back as a
+// third binding.
+void medianTiesExample()
+{
+    const std::vector<double> elements {2.0, 3.0, 3.0, 1.0, 3.0, 5.0, 3.0, 8.0, 0.5};
+
+    const auto [median_value, indices, ties] = medianWithTies(elements);
+    std::cout << "ties median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << " ties=";
+    printVector(ties.toIndices());
+    std::cout << std::endl;
+}
+
+
+// Records keep their fields in place; the median of one field is taken
+// through a pointer to member and reported by record index.
+void projectionMedianExample()
+{
+    struct Request
+    {
+        std::string path;
+        double latency;
+    };
+    const std::vector<Request> requests {
+        {"/a", 12.5}, {"/b", 3.0}, {"/c", 48.0}, {"/d", 7.5}, {"/e", 9.0}
+        };
+
+    const auto [median_value, indices] = median(requests, &Request::latency);
+    std::cout << "projection median_value=" << median_value << " path="
+        << requests[indices.front()].path << std::endl;
+}
+
+
+// The median latency in milliseconds of the successful (positive)
+// samples, without materializing the filtered or the converted values.
+void fusedMedianExample()
+{
+    const std::vector<double> seconds {0.120, -1.0, 0.045, 0.300, -1.0, 0.080};
+    const auto [median_value, indices] = fusedMedian(seconds,
+        [](double s) { return s > 0; }, [](double s) { return s * 1000; });
+    std::cout << "fused median_value=" << median_value << " indices=";
+    printVector(indices);
+    std::cout << std::endl;
+}
+
+
+// Strings have no mean, so an even count reports both central keys
+// together with their indices.
+void stringMedianExample()
+{
+    const std::vector<std::string> urls {
+        "https://example.com/b", "https://example.com/a/2", "https://example.com/c",
+        "https://example.com/a/10"
+        };
+
+    const auto [median_keys, indices] = stringMedian(urls);
+    std::cout << "string median_keys=";
+    printVector(median_keys);
+    std::cout << " indices=";
+    printVector(indices);
+    std::cout << std::endl;
+}
+
+
+// Prints every column's name and median with the data rows (0-based,
+// header excluded) it was computed from.
+void printColumnMedians(const std::vector<std::string>& names,
+    const std::vector<MedianResult>& medians)
+{
+    for (size_t column = 0; column < medians.size(); ++column)
+    {
+        const auto& [median_value, indices] = medians[column];
+        std::cout << names[column] << " median_value=" << median_value << " rows=";
+        printVector(indices);
+        std::cout << std::endl;
+    }
+}
+
+
+// Medians of the columns of a CSV file, read whole and parsed in parallel.
+int csvMedians(const std::string& path)
+{
+    std::string text;
+    if (!readFile(path, text))
+    {
+        std::cerr << "cannot read " << path << std::endl;
+        return 1;
+    }
+
+    const auto table = parseCsv(text);
+    printColumnMedians(table.names, columnMedians(table));
+    return 0;
+}
+
+
+// Medians of the columns of a CSV file or of standard input ("-"), with
+// reading, parsing and accumulation overlapped.
+int pipelinedCsvMedians(const std::string& path)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "cannot read " << path << std::endl;
+            return 1;
+        }
+    }
+
+    const auto [names, medians] = pipelinedColumnMedians(path == "-" ? std::cin : file);
+    printColumnMedians(names, medians);
+    return 0;
+}
+
+
 // Entry point to the application.
 // In this example we are going to a median value of an array of floats.
 // In particular we want to figure out not just the median value itself,
@@ -36,8 +522,20 @@ void printVector(const std::vector<T>& vector)
 // was calculated. We get 2 indices when the array is of an odd size,
 // and to preserve symmetry we have to take 2 central elements of
 // the sorted array.
-int main()
+int main(int argc, char* argv[])
 {
+    // "structured-bindings --csv <file>" reports the median of every
+    // column of a CSV file instead of running the examples;
+    // "--pipelined <file or ->" does the same on a stream.
+    if (argc == 3 && std::string(argv[1]) == "--csv")
+    {
+        return csvMedians(argv[2]);
+    }
+    if (argc == 3 && std::string(argv[1]) == "--pipelined")
+    {
+        return pipelinedCsvMedians(argv[2]);
+    }
+
     // Let's create an vector of floats to run our algorithm on.
     const std::vector<double> elements {
         1.2, 1.1, -0.1, -0.2, 0, 1
@@ -139,5 +637,29 @@ int main()
         std::cout << std::endl;
     }
 
+    // The other routines of this repository follow the same pattern.
+    theilSenExample();
+    medianPolishExample();
+    bootstrapExample();
+    hampelExample();
+    bucketedMedianExample();
+    timeWindowMedianExample();
+    maskedMedianExample();
+    approximateMedianExample();
+    gatherMedianExample();
+    sortedRunsMedianExample();
+    sparseMedianExample();
+    runLengthMedianExample();
+    dictionaryMedianExample();
+    compressedMedianExample();
+    medianCacheExample();
+    trackedArrayExample();
+    appendStoreExample();
+    lazyMedianExample();
+    medianTiesExample();
+    projectionMedianExample();
+    fusedMedianExample();
+    stringMedianExample();
+
     return 0;
 }
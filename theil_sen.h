@@ -0,0 +1,832 @@
+// Theil-Sen and Siegel repeated-median slope estimators.
+//
+// Theil-Sen takes the median of all n*(n-1)/2 pairwise slopes. Instead of
+// materializing them we use randomized slope selection: for a slope t the
+// points ordered by their intercept y - t*x change order exactly for the
+// pairs whose slope was crossed, so the number of slopes inside (lo, hi]
+// is the number of inversions between the two orderings. Counting those
+// with a merge sort is O(n log n), and the same merge lets us draw random
+// slopes from the interval, narrowing it until it is small enough to be
+// enumerated and selected from directly.
+//
+// The repeated median narrows a slope interval the same way. Counting the
+// inversions every point takes part in gives, per point, how many of its
+// slopes lie below a bound, which tells on which side of the bound the
+// point's median falls without computing it.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+#include "parallel.h"
+
+
+// A pair of point indices (i, j) whose slope defines an estimate.
+using PointPair = std::pair<size_t, size_t>;
+
+// The result of a robust line fit: slope, intercept and the point pair(s)
+// the slope was taken from (two pairs when it is the mean of two slopes).
+using LineFit = std::tuple<double, double, std::vector<PointPair> >;
+
+
+// Orders points by intercept y - t*x just above the slope t, or just
+// below it when "above" is false. Ties are broken the way an
+// infinitesimally larger (smaller) t would break them, larger (smaller) x
+// first, then by index, so that pairs with slope exactly t count as
+// already crossed (not yet crossed). Infinite t order the points by x.
+inline std::vector<uint32_t> orderAtSlope(
+    const std::vector<double>& x, const std::vector<double>& y, double t,
+    bool above = true)
+{
+    std::vector<uint32_t> order(x.size());
+    std::iota(order.begin(), order.end(), 0u);
+
+    if (t == -std::numeric_limits<double>::infinity())
+    {
+        std::sort(order.begin(), order.end(), [&](auto a, auto b)
+            { return std::tie(x[a], y[a], a) < std::tie(x[b], y[b], b); });
+    }
+    else if (t == std::numeric_limits<double>::infinity())
+    {
+        std::sort(order.begin(), order.end(), [&](auto a, auto b)
+            { return std::make_tuple(-x[a], y[a], a) <
+                std::make_tuple(-x[b], y[b], b); });
+    }
+    else
+    {
+        const double tieSign = above ? -1.0 : 1.0;
+        std::vector<double> key(x.size());
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            key[i] = y[i] - t * x[i];
+        }
+        std::sort(order.begin(), order.end(), [&](auto a, auto b)
+            { return std::make_tuple(key[a], tieSign * x[a], a) <
+                std::make_tuple(key[b], tieSign * x[b], b); });
+    }
+    return order;
+}
+
+
+// Merges two sorted runs of distinct values and reports every inversion
+// block to the visitor: when an element of the right run overtakes the
+// remaining elements of the left run, they form consecutive inversions
+// starting at global rank "rank".
+template<typename Visitor>
+uint64_t mergeCountingInversions(
+    const uint32_t* left, size_t leftSize,
+    const uint32_t* right, size_t rightSize,
+    uint32_t* out, uint64_t rank, Visitor& visit)
+{
+    size_t i = 0, j = 0, k = 0;
+    uint64_t count = 0;
+    while (i < leftSize && j < rightSize)
+    {
+        if (left[i] < right[j])
+        {
+            out[k++] = left[i++];
+        }
+        else
+        {
+            visit(left + i, leftSize - i, right[j], rank + count);
+            count += leftSize - i;
+            out[k++] = right[j++];
+        }
+    }
+    std::copy(left + i, left + leftSize, out + k);
+    std::copy(right + j, right + rightSize, out + k + (leftSize - i));
+    return count;
+}
+
+
+// Bottom-up merge sort of a run of distinct values that returns the
+// number of inversions and reports them to the visitor in rank order.
+template<typename Visitor>
+uint64_t sortCountingInversions(
+    uint32_t* data, uint32_t* buffer, size_t size, uint64_t rank,
+    Visitor& visit)
+{
+    uint64_t count = 0;
+    uint32_t* source = data;
+    uint32_t* target = buffer;
+    for (size_t width = 1; width < size; width *= 2)
+    {
+        for (size_t start = 0; start < size; start += 2 * width)
+        {
+            const auto middle = std::min(size, start + width);
+            const auto end = std::min(size, start + 2 * width);
+            count += mergeCountingInversions(
+                source + start, middle - start,
+                source + middle, end - middle,
+                target + start, rank + count, visit);
+        }
+        std::swap(source, target);
+    }
+    if (source != data)
+    {
+        std::copy(source, source + size, data);
+    }
+    return count;
+}
+
+
+// Maps the points of "from" to their positions in "to": the sequence of
+// which the inversions are exactly the pairs that changed order.
+inline std::vector<uint32_t> relativeOrder(
+    const std::vector<uint32_t>& from, const std::vector<uint32_t>& to)
+{
+    std::vector<uint32_t> position(to.size());
+    for (size_t i = 0; i < to.size(); ++i)
+    {
+        position[to[i]] = static_cast<uint32_t>(i);
+    }
+    std::vector<uint32_t> sequence(from.size());
+    for (size_t i = 0; i < from.size(); ++i)
+    {
+        sequence[i] = position[from[i]];
+    }
+    return sequence;
+}
+
+
+// Counts inversions of a sequence, sorting chunks on separate threads and
+// then merging pairs of runs level by level, also in parallel.
+inline uint64_t countInversions(std::vector<uint32_t> sequence)
+{
+    const auto size = sequence.size();
+    std::vector<uint32_t> buffer(size);
+    const auto noVisit = [](const uint32_t*, size_t, uint32_t, uint64_t) {};
+
+    const auto chunks = workerCount(size / 4096 + 1);
+    const auto chunkSize = (size + chunks - 1) / chunks;
+    std::vector<uint64_t> counts(chunks, 0);
+    parallelFor(chunks, [&](size_t begin, size_t end, size_t)
+    {
+        auto visit = noVisit;
+        for (size_t chunk = begin; chunk < end; ++chunk)
+        {
+            const auto first = std::min(size, chunk * chunkSize);
+            const auto last = std::min(size, first + chunkSize);
+            counts[chunk] = sortCountingInversions(
+                sequence.data() + first, buffer.data() + first,
+                last - first, 0, visit);
+        }
+    });
+
+    for (size_t width = chunkSize; width < size; width *= 2)
+    {
+        const auto merges = (size + 2 * width - 1) / (2 * width);
+        std::vector<uint64_t> mergeCounts(merges, 0);
+        parallelFor(merges, [&](size_t begin, size_t end, size_t)
+        {
+            auto visit = noVisit;
+            for (size_t merge = begin; merge < end; ++merge)
+            {
+                const auto start = merge * 2 * width;
+                const auto middle = std::min(size, start + width);
+                const auto last = std::min(size, start + 2 * width);
+                mergeCounts[merge] = mergeCountingInversions(
+                    sequence.data() + start, middle - start,
+                    sequence.data() + middle, last - middle,
+                    buffer.data() + start, 0, visit);
+                std::copy(buffer.data() + start, buffer.data() + last,
+                    sequence.data() + start);
+            }
+        });
+        counts.insert(counts.end(), mergeCounts.begin(), mergeCounts.end());
+    }
+    return std::accumulate(counts.begin(), counts.end(), uint64_t{0});
+}
+
+
+// Calls visit(i, j) for the point pairs whose inversion ranks are listed
+// in "ranks" (sorted ascending), or for all of them when "ranks" is null.
+template<typename PairVisitor>
+void visitSlopes(
+    const std::vector<uint32_t>& from, const std::vector<uint32_t>& to,
+    const std::vector<uint64_t>* ranks, PairVisitor&& visitPair)
+{
+    auto sequence = relativeOrder(from, to);
+    std::vector<uint32_t> buffer(sequence.size());
+    size_t next = 0;
+    auto visit = [&](const uint32_t* block, size_t blockSize,
+        uint32_t overtaking, uint64_t rank)
+    {
+        if (ranks == nullptr)
+        {
+            for (size_t i = 0; i < blockSize; ++i)
+            {
+                visitPair(to[block[i]], to[overtaking]);
+            }
+            return;
+        }
+        while (next < ranks->size() && (*ranks)[next] < rank + blockSize)
+        {
+            visitPair(to[block[(*ranks)[next] - rank]], to[overtaking]);
+            ++next;
+        }
+    };
+    sortCountingInversions(
+        sequence.data(), buffer.data(), sequence.size(), 0, visit);
+}
+
+
+// Selects the slope of the given rank among all pairwise slopes of points
+// with distinct x. Returns the slope together with its point pair.
+inline std::pair<double, PointPair> selectSlope(
+    const std::vector<double>& x, const std::vector<double>& y,
+    uint64_t target)
+{
+    const auto n = x.size();
+    const auto slopeOf = [&](size_t i, size_t j)
+        { return (y[j] - y[i]) / (x[j] - x[i]); };
+
+    // The interval (lo, hi] contains the target rank; "below" slopes are
+    // at most lo and "inside" slopes lie within the interval.
+    auto lo = -std::numeric_limits<double>::infinity();
+    auto hi = std::numeric_limits<double>::infinity();
+    auto loOrder = orderAtSlope(x, y, lo);
+    auto hiOrder = orderAtSlope(x, y, hi);
+    uint64_t below = 0;
+    uint64_t inside = countInversions(relativeOrder(loOrder, hiOrder));
+
+    const uint64_t enumerationLimit = std::max<uint64_t>(4 * n, 1 << 16);
+    const size_t sampleSize = std::max<size_t>(n, 1024);
+    const auto margin = static_cast<size_t>(3 * std::sqrt(sampleSize)) + 1;
+    std::mt19937_64 generator(n);
+
+    while (inside > enumerationLimit)
+    {
+        // Draw slopes uniformly from the interval and bracket the target
+        // rank by sample quantiles a few standard deviations apart.
+        std::uniform_int_distribution<uint64_t> pick(0, inside - 1);
+        std::vector<uint64_t> ranks(sampleSize);
+        for (auto& rank : ranks)
+        {
+            rank = pick(generator);
+        }
+        std::sort(ranks.begin(), ranks.end());
+        std::vector<double> sample;
+        sample.reserve(sampleSize);
+        visitSlopes(loOrder, hiOrder, &ranks, [&](size_t i, size_t j)
+            { sample.push_back(slopeOf(i, j)); });
+        std::sort(sample.begin(), sample.end());
+
+        const auto position = static_cast<size_t>(
+            static_cast<double>(target - below) / inside * sampleSize);
+
+        // Keep whichever bound still encloses the target. An unlucky
+        // sample simply leaves the interval unchanged and we draw again.
+        if (position >= margin)
+        {
+            const auto newLo = sample[position - margin];
+            auto newLoOrder = orderAtSlope(x, y, newLo);
+            const auto count = countInversions(relativeOrder(loOrder, newLoOrder));
+            if (target >= below + count)
+            {
+                lo = newLo;
+                loOrder = std::move(newLoOrder);
+                below += count;
+                inside -= count;
+            }
+            else
+            {
+                // The target is at most newLo. As on the hi side, it may be
+                // among many slopes exactly equal to newLo; otherwise the
+                // interval shrinks to the open (lo, newLo).
+                auto openOrder = orderAtSlope(x, y, newLo, false);
+                const auto open = countInversions(relativeOrder(loOrder, openOrder));
+                if (target >= below + open)
+                {
+                    const std::vector<uint64_t> tieRank {target - below - open};
+                    PointPair pair;
+                    visitSlopes(openOrder, newLoOrder, &tieRank,
+                        [&](size_t i, size_t j) { pair = PointPair(i, j); });
+                    return std::make_pair(newLo, pair);
+                }
+                hi = newLo;
+                hiOrder = std::move(openOrder);
+                inside = open;
+                continue;
+            }
+        }
+        if (position + margin < sampleSize)
+        {
+            const auto newHi = sample[position + margin];
+            auto newHiOrder = orderAtSlope(x, y, newHi);
+            const auto count = countInversions(relativeOrder(loOrder, newHiOrder));
+            if (target < below + count)
+            {
+                hi = newHi;
+                hiOrder = std::move(newHiOrder);
+                inside = count;
+
+                // Many slopes may be exactly equal to hi and never be split
+                // by sampling. Either the target is among them, or the
+                // interval can be shrunk to the open (lo, hi).
+                auto openOrder = orderAtSlope(x, y, hi, false);
+                const auto open = countInversions(relativeOrder(loOrder, openOrder));
+                if (target >= below + open)
+                {
+                    const std::vector<uint64_t> tieRank {target - below - open};
+                    PointPair pair;
+                    visitSlopes(openOrder, hiOrder, &tieRank,
+                        [&](size_t i, size_t j) { pair = PointPair(i, j); });
+                    return std::make_pair(hi, pair);
+                }
+                hiOrder = std::move(openOrder);
+                inside = open;
+            }
+        }
+    }
+
+    std::vector<std::pair<double, PointPair> > slopes;
+    slopes.reserve(inside);
+    visitSlopes(loOrder, hiOrder, nullptr, [&](size_t i, size_t j)
+        { slopes.emplace_back(slopeOf(i, j), PointPair(i, j)); });
+
+    const auto nth = slopes.begin() + (target - below);
+    std::nth_element(slopes.begin(), nth, slopes.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    return *nth;
+}
+
+
+// Median of the residual intercepts y - slope*x.
+inline double medianIntercept(
+    const std::vector<double>& x, const std::vector<double>& y, double slope)
+{
+    std::vector<std::pair<size_t, double> > intercepts;
+    intercepts.reserve(x.size());
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        intercepts.emplace_back(i, y[i] - slope * x[i]);
+    }
+    return std::get<0>(selectMedian(intercepts));
+}
+
+
+// Theil-Sen estimator: the median of the slopes through all pairs of
+// points with distinct x, in expected O(n log n) time and O(n) memory.
+// Returns NaN and no pairs when there is no such pair.
+inline LineFit theilSen(const std::vector<double>& x, const std::vector<double>& y)
+{
+    auto result = std::make_tuple(
+        std::numeric_limits<double>::quiet_NaN(),
+        std::numeric_limits<double>::quiet_NaN(),
+        std::vector<PointPair>());
+
+    if (x.size() != y.size() || x.size() < 2)
+    {
+        return result;
+    }
+
+    const auto total = countInversions(relativeOrder(
+        orderAtSlope(x, y, -std::numeric_limits<double>::infinity()),
+        orderAtSlope(x, y, std::numeric_limits<double>::infinity())));
+    if (total == 0)
+    {
+        return result;
+    }
+
+    double sum = 0.0;
+    std::vector<PointPair> pairs;
+    const auto ranks = middleRanks(total);
+    for (const auto rank : ranks)
+    {
+        const auto [slope, pair] = selectSlope(x, y, rank);
+        sum += slope;
+        pairs.push_back(pair);
+    }
+    const auto slope = sum / ranks.size();
+
+    return std::make_tuple(slope, medianIntercept(x, y, slope), pairs);
+}
+
+
+// For every point of "from", the number of pairs it forms that have
+// changed order in "to". With "from" ordered by x and "to" ordered at a
+// slope, that is the number of its slopes up to that slope. The element
+// at position p of the relative order, with value v and "less" smaller
+// values before it, has p - less larger values before it and v - less
+// smaller values after it; "less" comes from a Fenwick tree.
+inline std::vector<uint32_t> inversionsPerPoint(
+    const std::vector<uint32_t>& from, const std::vector<uint32_t>& to)
+{
+    const auto sequence = relativeOrder(from, to);
+    const auto n = sequence.size();
+    std::vector<uint32_t> tree(n + 1, 0);
+    std::vector<uint32_t> counts(n);
+    for (size_t p = 0; p < n; ++p)
+    {
+        const size_t value = sequence[p];
+        size_t less = 0;
+        for (auto node = value; node > 0; node &= node - 1)
+        {
+            less += tree[node];
+        }
+        for (auto node = value + 1; node <= n; node += node & (~node + 1))
+        {
+            ++tree[node];
+        }
+        counts[from[p]] = static_cast<uint32_t>(p + value - 2 * less);
+    }
+    return counts;
+}
+
+
+// The median slope from single points to all points with another x,
+// computed on demand in O(n) each and remembered, with the partner(s)
+// the median was taken from.
+class PointMedians
+{
+public:
+    PointMedians(const std::vector<double>& x, const std::vector<double>& y) :
+        x_(x), y_(y), medians_(x.size(), std::numeric_limits<double>::quiet_NaN()),
+        partners_(x.size()), known_(x.size(), false) {}
+
+    bool known(size_t i) const { return known_[i]; }
+    double median(size_t i) const { return medians_[i]; }
+    const std::vector<size_t>& partners(size_t i) const { return partners_[i]; }
+
+    void set(size_t i, double median, std::vector<size_t> partners)
+    {
+        medians_[i] = median;
+        partners_[i] = std::move(partners);
+        known_[i] = true;
+    }
+
+    // Computes the medians of the listed points that are not known yet,
+    // in parallel with one slope workspace per worker.
+    void compute(const std::vector<uint32_t>& points)
+    {
+        std::vector<uint32_t> missing;
+        for (const auto i : points)
+        {
+            if (!known_[i])
+            {
+                missing.push_back(i);
+            }
+        }
+        std::vector<std::vector<std::pair<size_t, double> > > workspaces(
+            workerCount(missing.size()));
+        parallelFor(missing.size(), [&](size_t begin, size_t end, size_t worker)
+        {
+            auto& slopes = workspaces[worker];
+            for (size_t k = begin; k < end; ++k)
+            {
+                const auto i = missing[k];
+                slopes.clear();
+                for (size_t j = 0; j < x_.size(); ++j)
+                {
+                    if (x_[j] != x_[i])
+                    {
+                        slopes.emplace_back(j, (y_[j] - y_[i]) / (x_[j] - x_[i]));
+                    }
+                }
+                std::tie(medians_[i], partners_[i]) = selectMedian(slopes);
+            }
+        });
+        for (const auto i : missing)
+        {
+            known_[i] = true;
+        }
+    }
+
+private:
+    const std::vector<double>& x_;
+    const std::vector<double>& y_;
+    std::vector<double> medians_;
+    std::vector<std::vector<size_t> > partners_;
+    std::vector<bool> known_;
+};
+
+
+// One end of a slope interval: the points ordered at it, how many slopes
+// of every point lie up to it, and which points have their median slope
+// up to it. An open bound excludes the slopes equal to "slope".
+struct SlopeBound
+{
+    double slope = 0.0;
+    bool open = false;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> counts;
+    std::vector<bool> below;
+    size_t belowCount = 0;
+};
+
+
+// The bound at slope t. "xOrder" is the order at minus infinity and
+// "totals" the number of slopes of every point. A point's median is
+// decided by its count alone, except when it is the mean of two slopes
+// on either side of t; those few points have theirs computed exactly.
+inline SlopeBound slopeBound(
+    const std::vector<double>& x, const std::vector<double>& y,
+    const std::vector<uint32_t>& xOrder, const std::vector<uint32_t>& totals,
+    double t, bool open, PointMedians& medians)
+{
+    SlopeBound bound;
+    bound.slope = t;
+    bound.open = open;
+    bound.order = orderAtSlope(x, y, t, !open);
+    bound.counts = inversionsPerPoint(xOrder, bound.order);
+
+    const auto n = x.size();
+    std::vector<uint32_t> straddling;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (totals[i] > 0 && totals[i] % 2 == 0 && bound.counts[i] == totals[i] / 2)
+        {
+            straddling.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    medians.compute(straddling);
+
+    bound.below.assign(n, false);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (totals[i] == 0)
+        {
+            continue;
+        }
+        const auto lower = (totals[i] - 1) / 2;
+        const auto upper = totals[i] / 2;
+        const auto count = bound.counts[i];
+        const auto median = medians.median(i);
+        bound.below[i] = count > upper ||
+            (count > lower && (open ? median < t : median <= t));
+        bound.belowCount += bound.below[i];
+    }
+    return bound;
+}
+
+
+// Selects the points whose median slopes have the consecutive ranks
+// [first, last] among the points with "totals" > 0, given a slope
+// interval (lo, hi] that holds them: lo has at most "first" medians up to
+// it and hi more than "last". Like selectSlope, the interval is narrowed,
+// here by binary search over a sorted sample of the slopes inside it, and
+// every probe costs one ordering and one inversion count. A probe that
+// falls between the ranks splits the search. Once few slopes remain they
+// are enumerated and every candidate point's median is taken from its own.
+inline std::vector<size_t> selectPointMedians(
+    const std::vector<double>& x, const std::vector<double>& y,
+    const std::vector<uint32_t>& xOrder, const std::vector<uint32_t>& totals,
+    SlopeBound lo, SlopeBound hi, size_t first, size_t last,
+    PointMedians& medians)
+{
+    const auto n = x.size();
+    const auto slopeOf = [&](size_t i, size_t j)
+        { return (y[j] - y[i]) / (x[j] - x[i]); };
+    const auto insideOf = [&](const SlopeBound& a, const SlopeBound& b)
+    {
+        uint64_t inside = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            inside += b.counts[i] - a.counts[i];
+        }
+        return inside / 2;
+    };
+    // The points whose medians lie in (a, b], in index order.
+    const auto between = [&](const SlopeBound& a, const SlopeBound& b)
+    {
+        std::vector<uint32_t> points;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (b.below[i] && !a.below[i])
+            {
+                points.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return points;
+    };
+
+    auto inside = insideOf(lo, hi);
+    const uint64_t enumerationLimit = std::max<uint64_t>(4 * n, 1 << 16);
+    const size_t sampleSize = 1024;
+    std::mt19937_64 generator(n + first);
+
+    while (inside > enumerationLimit)
+    {
+        std::uniform_int_distribution<uint64_t> pick(0, inside - 1);
+        std::vector<uint64_t> ranks(sampleSize);
+        for (auto& rank : ranks)
+        {
+            rank = pick(generator);
+        }
+        std::sort(ranks.begin(), ranks.end());
+        std::vector<double> sample;
+        sample.reserve(sampleSize);
+        visitSlopes(lo.order, hi.order, &ranks, [&](size_t i, size_t j)
+            { sample.push_back(slopeOf(i, j)); });
+        std::sort(sample.begin(), sample.end());
+
+        // Slopes equal to hi are never split by probing, and with many of
+        // them it stalls. Either some of the ranks have hi itself as their
+        // median, or hi is made open and they all leave the interval.
+        if (!hi.open && sample.back() == hi.slope)
+        {
+            auto openHi = slopeBound(x, y, xOrder, totals, hi.slope, true, medians);
+            if (openHi.belowCount <= last)
+            {
+                std::vector<size_t> points;
+                if (openHi.belowCount > first)
+                {
+                    points = selectPointMedians(x, y, xOrder, totals, std::move(lo),
+                        openHi, first, openHi.belowCount - 1, medians);
+                }
+                const auto tied = between(openHi, hi);
+                for (auto rank = std::max(first, openHi.belowCount); rank <= last; ++rank)
+                {
+                    const auto i = tied[rank - openHi.belowCount];
+                    medians.compute({i});
+                    points.push_back(i);
+                }
+                return points;
+            }
+            hi = std::move(openHi);
+        }
+        else
+        {
+            // Probing stops once the sample suggests that few enough
+            // slopes are left between the probed ones.
+            size_t begin = 0;
+            size_t end = sample.size();
+            while (begin < end && inside / sampleSize * (end - begin + 1) > enumerationLimit / 2)
+            {
+                const auto middle = begin + (end - begin) / 2;
+                const auto t = sample[middle];
+                if (t <= lo.slope)
+                {
+                    begin = middle + 1;
+                    continue;
+                }
+                if (t >= hi.slope)
+                {
+                    end = middle;
+                    continue;
+                }
+                auto probe = slopeBound(x, y, xOrder, totals, t, false, medians);
+                if (probe.belowCount > last)
+                {
+                    hi = std::move(probe);
+                    end = middle;
+                }
+                else if (probe.belowCount <= first)
+                {
+                    lo = std::move(probe);
+                    begin = middle + 1;
+                }
+                else
+                {
+                    const auto split = probe.belowCount;
+                    auto points = selectPointMedians(x, y, xOrder, totals, std::move(lo),
+                        probe, first, split - 1, medians);
+                    const auto upper = selectPointMedians(x, y, xOrder, totals,
+                        std::move(probe), std::move(hi), split, last, medians);
+                    points.insert(points.end(), upper.begin(), upper.end());
+                    return points;
+                }
+            }
+        }
+
+        // Rounding can make slopes compare equal to a bound they are
+        // ordered inside of; stop narrowing rather than spin on them.
+        const auto narrowed = insideOf(lo, hi);
+        if (narrowed == inside)
+        {
+            break;
+        }
+        inside = narrowed;
+    }
+
+    // The candidates have their median inside the interval. Those not
+    // computed yet have both middle slopes inside, so the slopes inside
+    // are gathered per candidate and its middle ranks selected from them.
+    const auto candidates = between(lo, hi);
+    std::vector<uint64_t> offsets(n + 1, 0);
+    for (const auto i : candidates)
+    {
+        offsets[i + 1] = medians.known(i) ? 0 : hi.counts[i] - lo.counts[i];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<std::pair<size_t, double> > slopes(offsets[n]);
+    auto fill = offsets;
+    visitSlopes(lo.order, hi.order, nullptr, [&](size_t i, size_t j)
+    {
+        if (offsets[i + 1] > offsets[i])
+        {
+            slopes[fill[i]++] = std::make_pair(j, slopeOf(i, j));
+        }
+        if (offsets[j + 1] > offsets[j])
+        {
+            slopes[fill[j]++] = std::make_pair(i, slopeOf(i, j));
+        }
+    });
+
+    const auto byValue = [](const auto& a, const auto& b) { return a.second < b.second; };
+    std::vector<std::pair<size_t, double> > candidateMedians;
+    for (const auto i : candidates)
+    {
+        if (!medians.known(i))
+        {
+            const auto begin = slopes.begin() + offsets[i];
+            const auto end = slopes.begin() + offsets[i + 1];
+            const auto lower = begin + ((totals[i] - 1) / 2 - lo.counts[i]);
+            std::nth_element(begin, lower, end, byValue);
+            std::vector<size_t> partners {lower->first};
+            auto median = lower->second;
+            if (totals[i] % 2 == 0)
+            {
+                const auto upper = std::min_element(lower + 1, end, byValue);
+                partners.push_back(upper->first);
+                median = (median + upper->second) / 2;
+            }
+            medians.set(i, median, partners);
+        }
+        candidateMedians.emplace_back(i, medians.median(i));
+    }
+
+    std::vector<size_t> points;
+    auto from = candidateMedians.begin();
+    for (auto rank = first; rank <= last; ++rank)
+    {
+        const auto nth = candidateMedians.begin() + (rank - lo.belowCount);
+        std::nth_element(from, nth, candidateMedians.end(), byValue);
+        points.push_back(nth->first);
+        from = nth + 1;
+    }
+    return points;
+}
+
+
+// Siegel's repeated-median estimator: for every point the median of its
+// slopes to all points with another x, then the median of those. The
+// central point(s) are selected without computing every point's median,
+// in expected O(n log^2 n) time and O(n) memory.
+inline LineFit repeatedMedian(const std::vector<double>& x, const std::vector<double>& y)
+{
+    auto result = std::make_tuple(
+        std::numeric_limits<double>::quiet_NaN(),
+        std::numeric_limits<double>::quiet_NaN(),
+        std::vector<PointPair>());
+
+    if (x.size() != y.size() || x.size() < 2)
+    {
+        return result;
+    }
+
+    // Every point has a slope to each point with another x.
+    const auto n = x.size();
+    const auto xOrder = orderAtSlope(x, y, -std::numeric_limits<double>::infinity());
+    std::vector<uint32_t> totals(n);
+    size_t defined = 0;
+    for (size_t first = 0; first < n;)
+    {
+        auto last = first;
+        while (last < n && x[xOrder[last]] == x[xOrder[first]])
+        {
+            ++last;
+        }
+        for (auto k = first; k < last; ++k)
+        {
+            totals[xOrder[k]] = static_cast<uint32_t>(n - (last - first));
+        }
+        defined += totals[xOrder[first]] > 0 ? last - first : 0;
+        first = last;
+    }
+    if (defined == 0)
+    {
+        return result;
+    }
+
+    PointMedians medians(x, y);
+    const auto ranks = middleRanks(defined);
+    const auto points = selectPointMedians(x, y, xOrder, totals,
+        slopeBound(x, y, xOrder, totals, -std::numeric_limits<double>::infinity(), false, medians),
+        slopeBound(x, y, xOrder, totals, std::numeric_limits<double>::infinity(), false, medians),
+        ranks.front(), ranks.back(), medians);
+
+    double sum = 0.0;
+    std::vector<PointPair> pairs;
+    for (const auto i : points)
+    {
+        sum += medians.median(i);
+        for (const auto j : medians.partners(i))
+        {
+            pairs.emplace_back(i, j);
+        }
+    }
+    const auto slope = sum / points.size();
+
+    return std::make_tuple(slope, medianIntercept(x, y, slope), pairs);
+}
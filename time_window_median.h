@@ -0,0 +1,134 @@
+// Sliding median over a time-based window.
+//
+// "Median of the last five minutes" holds a varying number of events, so
+// the window is kept as two balanced ordered sets (the lower and the upper
+// half of the values) plus an index of the events by timestamp for
+// eviction. Every insertion and eviction is O(log n), and the median is
+// read from the boundary between the halves.
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// Streaming median of the events with timestamps in (latest - window,
+// latest], where latest is the largest timestamp seen so far. Events may
+// arrive out of order by up to "tolerance"; later ones are rejected.
+class TimeWindowMedian
+{
+public:
+    TimeWindowMedian(int64_t window, int64_t tolerance = 0) :
+        window_(window), tolerance_(tolerance) {}
+
+    // Adds the next event; its index is its position in the stream,
+    // counting rejected events too. Returns false for an event that
+    // arrived more than "tolerance" behind the latest timestamp.
+    bool push(int64_t timestamp, double value)
+    {
+        const auto index = count_++;
+        if (!events_.empty() && timestamp < latest_ - tolerance_)
+        {
+            return false;
+        }
+        if (events_.empty() || timestamp > latest_)
+        {
+            latest_ = timestamp;
+        }
+
+        // A late event may already lie outside of the window; it is then
+        // accepted but has nothing to contribute.
+        if (timestamp > latest_ - window_)
+        {
+            events_.emplace(timestamp, Entry(value, index));
+            insert(Entry(value, index));
+        }
+        evict();
+        return true;
+    }
+
+    // Median of the current window with the stream indices it came from.
+    MedianResult median() const
+    {
+        if (lower_.empty())
+        {
+            return emptyMedianResult();
+        }
+        const auto& middle = *lower_.rbegin();
+        if (lower_.size() > upper_.size())
+        {
+            return std::make_tuple(middle.first, std::vector<size_t>{middle.second});
+        }
+        const auto& next = *upper_.begin();
+        return std::make_tuple((middle.first + next.first) / 2,
+            std::vector<size_t>{middle.second, next.second});
+    }
+
+    // Number of events in the window.
+    size_t size() const { return lower_.size() + upper_.size(); }
+
+private:
+    // Values are paired with their indices, which makes entries unique.
+    using Entry = std::pair<double, size_t>;
+
+    void insert(const Entry& entry)
+    {
+        if (lower_.empty() || entry < *lower_.rbegin())
+        {
+            lower_.insert(entry);
+        }
+        else
+        {
+            upper_.insert(entry);
+        }
+        rebalance();
+    }
+
+    void erase(const Entry& entry)
+    {
+        if (lower_.erase(entry) == 0)
+        {
+            upper_.erase(entry);
+        }
+        rebalance();
+    }
+
+    // Keeps the lower half equal in size to the upper one or one larger.
+    void rebalance()
+    {
+        if (lower_.size() > upper_.size() + 1)
+        {
+            const auto last = std::prev(lower_.end());
+            upper_.insert(*last);
+            lower_.erase(last);
+        }
+        else if (upper_.size() > lower_.size())
+        {
+            lower_.insert(*upper_.begin());
+            upper_.erase(upper_.begin());
+        }
+    }
+
+    void evict()
+    {
+        while (!events_.empty() && events_.begin()->first <= latest_ - window_)
+        {
+            erase(events_.begin()->second);
+            events_.erase(events_.begin());
+        }
+    }
+
+    int64_t window_;
+    int64_t tolerance_;
+    int64_t latest_ = 0;
+    size_t count_ = 0;
+    std::set<std::pair<int64_t, Entry> > events_;
+    std::set<Entry> lower_;
+    std::set<Entry> upper_;
+};
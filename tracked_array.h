@@ -0,0 +1,204 @@
+// Incremental median recomputation over an array that changes a little
+// between queries.
+//
+// A TrackedArray records which ranges were modified and keeps the
+// partitioned (index, value) scratch from its last median query: the
+// elements below a band around the middle ranks, the band itself, and the
+// elements above it. A modified element only needs to move to the region
+// its new value belongs to, which is a couple of swaps at the region
+// boundaries. As long as the middle ranks still fall inside the band, the
+// next query selects within the band alone; only when updates push the
+// middle out of it is the whole array partitioned again, with a wider band.
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "median.h"
+
+
+// A fixed-size array of doubles with change tracking and an incrementally
+// maintained median.
+class TrackedArray
+{
+public:
+    explicit TrackedArray(std::vector<double> values) :
+        values_(std::move(values)) {}
+
+    size_t size() const { return values_.size(); }
+
+    double operator[](size_t index) const { return values_[index]; }
+
+    const std::vector<double>& values() const { return values_; }
+
+    // Changes one element and records it as modified.
+    void set(size_t index, double value)
+    {
+        values_[index] = value;
+        if (!dirty_.empty() && dirty_.back().second == index)
+        {
+            ++dirty_.back().second;
+        }
+        else if (dirty_.empty() || !(dirty_.back().first <= index && index < dirty_.back().second))
+        {
+            dirty_.emplace_back(index, index + 1);
+        }
+    }
+
+    // Modified ranges [begin, end) since the last median query.
+    const std::vector<std::pair<size_t, size_t> >& dirtyRanges() const { return dirty_; }
+
+    // Median with the indices of its central element(s).
+    MedianResult median()
+    {
+        const auto ranks = middleRanks(values_.size());
+        if (ranks.empty())
+        {
+            return emptyMedianResult();
+        }
+
+        // The first query has no partition to start from.
+        const auto first = scratch_.size() != values_.size();
+        size_t changed = 0;
+        if (!first)
+        {
+            for (const auto& [begin, end] : dirty_)
+            {
+                for (size_t index = begin; index < end; ++index)
+                {
+                    reposition(index);
+                }
+                changed += end - begin;
+            }
+        }
+        dirty_.clear();
+
+        if (first || ranks.front() < bandBegin_ || ranks.back() >= bandEnd_)
+        {
+            partition(changed);
+        }
+
+        // Select within the band only.
+        const auto byValue = [](const auto& a, const auto& b)
+            { return a.second < b.second; };
+        const auto band = scratch_.begin() + bandBegin_;
+        const auto upper = scratch_.begin() + ranks.back();
+        std::nth_element(band, upper, scratch_.begin() + bandEnd_, byValue);
+        for (auto position = bandBegin_; position < bandEnd_; ++position)
+        {
+            where_[scratch_[position].first] = position;
+        }
+
+        std::vector<size_t> originalIndices;
+        double sum = 0.0;
+        if (ranks.size() == 2)
+        {
+            const auto lower = std::max_element(band, upper, byValue);
+            originalIndices.push_back(lower->first);
+            sum += lower->second;
+        }
+        originalIndices.push_back(upper->first);
+        sum += upper->second;
+        return std::make_tuple(sum / originalIndices.size(), originalIndices);
+    }
+
+private:
+    // Partitions the whole array around the middle ranks with a band wide
+    // enough to absorb a few times the latest number of changes.
+    void partition(size_t changed)
+    {
+        const auto size = values_.size();
+        scratch_.resize(size);
+        where_.resize(size);
+        for (size_t index = 0; index < size; ++index)
+        {
+            scratch_[index] = std::make_pair(index, values_[index]);
+        }
+
+        const auto ranks = middleRanks(size);
+        const auto margin = std::max(kMinimumMargin, 4 * changed);
+        bandBegin_ = ranks.front() > margin ? ranks.front() - margin : 0;
+        bandEnd_ = std::min(size, ranks.back() + margin + 1);
+
+        const auto byValue = [](const auto& a, const auto& b)
+            { return a.second < b.second; };
+        std::nth_element(scratch_.begin(), scratch_.begin() + bandBegin_,
+            scratch_.end(), byValue);
+        if (bandEnd_ < size)
+        {
+            std::nth_element(scratch_.begin() + bandBegin_, scratch_.begin() + bandEnd_ - 1,
+                scratch_.end(), byValue);
+        }
+        for (size_t position = 0; position < size; ++position)
+        {
+            where_[scratch_[position].first] = position;
+        }
+
+        // Values outside [bandLow_, bandHigh_] belong to the outer regions.
+        bandLow_ = std::min_element(scratch_.begin() + bandBegin_,
+            scratch_.begin() + bandEnd_, byValue)->second;
+        bandHigh_ = std::max_element(scratch_.begin() + bandBegin_,
+            scratch_.begin() + bandEnd_, byValue)->second;
+    }
+
+    // Moves a modified element to the region its new value belongs to.
+    // Regions: below [0, bandBegin_), band [bandBegin_, bandEnd_), above
+    // [bandEnd_, size). Every move swaps with the nearest region boundary.
+    void reposition(size_t index)
+    {
+        const auto value = values_[index];
+        scratch_[where_[index]].second = value;
+
+        const auto region = [&](size_t position)
+            { return position < bandBegin_ ? 0 : position < bandEnd_ ? 1 : 2; };
+        const auto target = value < bandLow_ ? 0 : value > bandHigh_ ? 2 : 1;
+
+        while (region(where_[index]) < target)
+        {
+            if (region(where_[index]) == 0)
+            {
+                swapPositions(where_[index], bandBegin_ - 1);
+                --bandBegin_;
+            }
+            else
+            {
+                swapPositions(where_[index], bandEnd_ - 1);
+                --bandEnd_;
+            }
+        }
+        while (region(where_[index]) > target)
+        {
+            if (region(where_[index]) == 2)
+            {
+                swapPositions(where_[index], bandEnd_);
+                ++bandEnd_;
+            }
+            else
+            {
+                swapPositions(where_[index], bandBegin_);
+                ++bandBegin_;
+            }
+        }
+    }
+
+    void swapPositions(size_t a, size_t b)
+    {
+        std::swap(scratch_[a], scratch_[b]);
+        where_[scratch_[a].first] = a;
+        where_[scratch_[b].first] = b;
+    }
+
+    // Smallest number of ranks kept on either side of the middle.
+    static constexpr size_t kMinimumMargin = 64;
+
+    std::vector<double> values_;
+    std::vector<std::pair<size_t, size_t> > dirty_;
+    std::vector<std::pair<size_t, double> > scratch_;
+    std::vector<size_t> where_;
+    size_t bandBegin_ = 0;
+    size_t bandEnd_ = 0;
+    double bandLow_ = 0.0;
+    double bandHigh_ = 0.0;
+};